@@ -9,21 +9,39 @@
 #include "bar.h"
 #include "particle.h"
 #include "temporary_label.h"
-#include "renderer.h"
-#include "game.h"
+#include "constraint_table.h"
+#include "islands.h"
+#include "material.h"
 #include "various_math.h"
+#include <algorithm>
 
 SlotMap<Bar> bars;
 
-Bar::Bar(int id1, int id2, double e): p1_id(id1), p2_id(id2)
+// The masses of both particles depend on the bar
+static void lump_ends(const Bar& b)
 {
-    stiffness = 1.0;
-    set_strain(e);
+    particles[b.p1_id].lump_mass();
+    particles[b.p2_id].lump_mass();
+}
+
+Bar::Bar(int id1, int id2, double e): p1_id(id1), p2_id(id2), colour(0)
+{
+    material = materials.current;
+    static_force = 0.0;
+    static_strain = 0.0;
+    r0 = length() / (e + 1.0);
+}
+
+Bar::Bar(): p1_id(-1), p2_id(-1), r0(0.0), colour(0)
+{
+    material = materials.current;
+    static_force = 0.0;
+    static_strain = 0.0;
 }
 
 Vector2d Bar::unit12() const
 {
-    return (particles[p2_id].position_ - particles[p1_id].position_).norm();
+    return (particles[p2_id].position() - particles[p1_id].position()).norm();
 }
 
 Vector2d Bar::unit21() const
@@ -33,8 +51,8 @@ Vector2d Bar::unit21() const
 
 double Bar::length() const
 {
-    Vector2d pos1 = particles[p1_id].position_;
-    Vector2d pos2 = particles[p2_id].position_;
+    Vector2d pos1 = particles[p1_id].position();
+    Vector2d pos2 = particles[p2_id].position();
     return (pos1 - pos2).abs();
 }
 
@@ -46,6 +64,9 @@ double Bar::extension() const
 void Bar::set_strain(double e)
 {
     r0 = length() / (e + 1.0);
+    particles[p1_id].wake();
+    lump_ends(*this);
+    constraints.invalidate();
 }
 
 double Bar::get_strain() const
@@ -55,33 +76,47 @@ double Bar::get_strain() const
 
 bool Bar::is_fractured() const
 {
-    return abs_d(get_strain()) > MAX_STRAIN;
+    double strain = get_strain();
+    return strain > materials.tension_limit[material] || strain < -materials.compression_limit[material];
 }
 
-void Bar::impose_constraint()
+double Bar::get_static_force() const
 {
-    Particle& p1 = particles[p1_id];
-    Particle& p2 = particles[p2_id];
-    
-    double ext = extension();
-    
-    double im1 = 1/p1.mass_;
-    double im2 = 1/p1.mass_;
-    float mult1 = (im1 / (im1 + im2)) * stiffness;
-    float mult2 = stiffness - mult1;
-    
-    // If one particle is fixed, the other should move two times
-    // farther in the direction of the fixed particle.
-    if (!p1.fixed_ && !p2.fixed_)
+    return static_force;
+}
+
+double Bar::get_static_strain() const
+{
+    return static_strain;
+}
+
+void Bar::set_material(unsigned int m)
+{
+    if (m >= materials.size())
     {
-        p1.position_ += mult1 * ext * unit12();
-        p2.position_ += mult2 * ext * unit21();
+        issue_label("This material does not exist", WARNING_LABEL_TIME);
+        return;
     }
-    else if (!p1.fixed_) // and p2 is fixed
-        p1.position_ += 2 * mult1 * ext * unit12();
-    else if (!p2.fixed_) // and p1 is fixed
-        p2.position_ += 2 * mult2 * ext * unit21();
-    // else both are fixed
+    material = m;
+    particles[p1_id].wake();
+    lump_ends(*this);
+    constraints.invalidate();
+}
+
+unsigned int Bar::get_material() const
+{
+    return material;
+}
+
+double Bar::get_compliance() const
+{
+    double c = materials.compliance[material];
+    return c >= 0.0 ? c : r0 / materials.modulus[material];
+}
+
+double Bar::mass() const
+{
+    return materials.density[material] * r0;
 }
 
 int Bar::create(int id1, int id2)
@@ -115,15 +150,82 @@ int Bar::create(int id1, int id2, double e)
     }
     
     Bar new_bar(id1, id2, e);
+    
+    // Pick the lowest colour not used by the bars connected to either particle
+    std::vector<char> used;
+    for (int k = 0; k < 2; k++)
+    {
+        const std::vector<int>& connected = particles[k == 0 ? id1 : id2].bars_connected;
+        for (int i = 0; i < connected.size(); i++)
+        {
+            unsigned int c = bars[connected[i]].colour;
+            if (c >= used.size())
+                used.resize(c + 1, false);
+            used[c] = true;
+        }
+    }
+    new_bar.colour = 0;
+    while (new_bar.colour < used.size() && used[new_bar.colour])
+        new_bar.colour++;
+    
     int new_id = bars.add(new_bar);
     
     // Particles have to know which bars are connected to them
     particles[id1].bars_connected.push_back(new_id);
     particles[id2].bars_connected.push_back(new_id);
+    particles[id1].wake();
+    lump_ends(bars[new_id]);
+    
+    constraints.invalidate();
+    islands.invalidate();
 
     return new_id;
 }
 
+void Bar::create(const std::vector<int>& ends)
+{
+    bars.reserve(bars.size() + (unsigned int)ends.size() / 2);
+    std::vector<char> used;
+    for (int k = 0; k + 1 < ends.size(); k += 2)
+    {
+        int id1 = ends[k];
+        int id2 = ends[k+1];
+        Particle& p1 = particles[id1];
+        Particle& p2 = particles[id2];
+        
+        // Nothing is strained, so r0 is just the length
+        Bar new_bar;
+        new_bar.p1_id = id1;
+        new_bar.p2_id = id2;
+        new_bar.r0 = (p1.position() - p2.position()).abs();
+        
+        // The lowest colour not used by the bars connected to either particle
+        used.clear();
+        for (int j = 0; j < 2; j++)
+        {
+            const std::vector<int>& connected = (j == 0 ? p1 : p2).bars_connected;
+            for (int i = 0; i < connected.size(); i++)
+            {
+                unsigned int c = bars[connected[i]].colour;
+                if (c >= used.size())
+                    used.resize(c + 1, false);
+                used[c] = true;
+            }
+        }
+        new_bar.colour = 0;
+        while (new_bar.colour < used.size() && used[new_bar.colour])
+            new_bar.colour++;
+        
+        int new_id = bars.add(new_bar);
+        p1.bars_connected.push_back(new_id);
+        p2.bars_connected.push_back(new_id);
+    }
+    for (int k = 0; k < ends.size(); k++)
+        particles[ends[k]].lump_mass();
+    constraints.invalidate();
+    islands.invalidate();
+}
+
 int Bar::destroy(int obj_id)
 {
     if (!bars.exists(obj_id))
@@ -134,6 +236,8 @@ int Bar::destroy(int obj_id)
     
     Particle& p1 = particles[bars[obj_id].p1_id];
     Particle& p2 = particles[bars[obj_id].p2_id];
+    p1.wake();
+    p2.wake();
     
     for (int i = 0; i < p1.bars_connected.size(); i++)
     {
@@ -153,10 +257,74 @@ int Bar::destroy(int obj_id)
     }
     
     bars.remove(obj_id);
+    p1.lump_mass();
+    p2.lump_mass();
+    constraints.invalidate();
+    islands.invalidate();
     
     return 0;
 }
 
+void Bar::destroy(const std::vector<int>& obj_ids)
+{
+    // Mark the bars and find the particles they were connected to
+    std::vector<char> removed;
+    std::vector<char> touched(particles.size(), false);
+    std::vector<int> ends;
+    for (int i = 0; i < obj_ids.size(); i++)
+    {
+        int id = obj_ids[i];
+        if (!bars.exists(id))
+            continue;
+        if (id >= removed.size())
+            removed.resize(id + 1, false);
+        if (removed[id])
+            continue;
+        removed[id] = true;
+        
+        const Bar& b = bars[id];
+        for (int k = 0; k < 2; k++)
+        {
+            int index = particles.index(k == 0 ? b.p1_id : b.p2_id);
+            if (!touched[index])
+            {
+                touched[index] = true;
+                ends.push_back(index);
+            }
+        }
+    }
+    if (ends.empty())
+        return;
+    
+    // Each particle drops all its removed bars at once
+    for (int i = 0; i < ends.size(); i++)
+    {
+        Particle& p = particles.at(ends[i]);
+        p.wake();
+        std::vector<int>& connected = p.bars_connected;
+        connected.erase(std::remove_if(connected.begin(), connected.end(), [&](int bar_id)
+        {
+            return bar_id < removed.size() && removed[bar_id];
+        }), connected.end());
+    }
+    
+    std::vector<unsigned int> positions;
+    bars.remove(obj_ids, positions);
+    for (int i = 0; i < ends.size(); i++)
+        particles.at(ends[i]).lump_mass();
+    
+    // The islands stay valid, some of them just hold structures which
+    // aren't connected any more. They are split at the next rebuild.
+    constraints.remove_bars(removed);
+}
+
+void Bar::clear()
+{
+    bars.clear();
+    constraints.invalidate();
+    islands.invalidate();
+}
+
 void Bar::split(int bar_id, unsigned int n_parts)
 {
     if (!bars.exists(bar_id))
@@ -176,18 +344,19 @@ void Bar::split(int bar_id, unsigned int n_parts)
     
     int id_start = this_bar.p1_id;
     int id_end = this_bar.p2_id;
-    Vector2d pos_start = particles[id_start].position_;
-    Vector2d pos_end = particles[id_end].position_;
+    Vector2d pos_start = particles[id_start].position();
+    Vector2d pos_end = particles[id_end].position();
     
     double new_r0 = this_bar.r0 / n_parts;
+    unsigned char material = this_bar.material;
     Vector2d Dr = (pos_end - pos_start) / n_parts;
     
     // Create new particles
     std::vector<int> new_ids;
     for (int i = 1; i < n_parts; i++)
     {
-        int new_id = particles.add(Particle(pos_start.x + i * Dr.x,
-                                            pos_start.y + i * Dr.y, false));
+        int new_id = Particle::create(pos_start.x + i * Dr.x,
+                                      pos_start.y + i * Dr.y, false);
         new_ids.push_back(new_id);
     }
     
@@ -208,12 +377,10 @@ void Bar::split(int bar_id, unsigned int n_parts)
             new_bar_id = Bar::create(new_ids[i-1], new_ids[i]);
         
         bars[new_bar_id].r0 = new_r0;
+        bars[new_bar_id].material = material;
+        lump_ends(bars[new_bar_id]);
     }
-}
-
-void Bar::draw(const Renderer& rend) const
-{
-    rend.render(*this);
+    constraints.invalidate();
 }
 
 void print_bars()
@@ -9,15 +9,18 @@
 #ifndef __Trusses__bar__
 #define __Trusses__bar__
 
+#include <vector>
 #include "slot_map.h"
+#include "vector2d.h"
 
-#define MAX_STRAIN 0.3
-
-class Renderer;
-class Vector2d;
+class ConstraintTable;
+class StaticSolver;
 
 class Bar
 {
+    friend class ConstraintTable;
+    friend class StaticSolver;
+    friend class Journal;
 public:
     int id_;
     
@@ -40,32 +43,73 @@ public:
     void set_strain(double e);
     double get_strain() const;
     
-    // If true, bar can be destroyed
+    // If true, bar can be destroyed. The limits
+    // are given by the material of the bar.
     bool is_fractured() const;
     
-    // Imposes constraints on the particles
-    // it's connected to
-    void impose_constraint();
+    // Axial force (tension is +ve) and strain in the equilibrium
+    // found by the last StaticSolver::solve
+    double get_static_force() const;
+    double get_static_strain() const;
+    
+    // Index of the material of the bar in the material table
+    void set_material(unsigned int m);
+    unsigned int get_material() const;
+    
+    // Rest length divided by the modulus of the material, or the
+    // compliance of a legacy material (see MaterialTable::legacy).
+    // Zero compliance means a perfectly rigid bar.
+    double get_compliance() const;
     
+    // Mass of the bar (linear density times rest length),
+    // half of which is lumped into each of its particles
+    double mass() const;
+    
+    // New bars are made of the current material (see MaterialTable)
     static int create(int id1, int id2);
     static int create(int id1, int id2, double e);
+    
+    // Creates unstrained bars between the particles ends[2k] and
+    // ends[2k+1]. Meant for generated structures: the particles are
+    // assumed to exist and the pairs to be distinct, nothing is checked.
+    static void create(const std::vector<int>& ends);
     static int destroy(int obj_id);
     
+    // Destroys the bars together: the lists of connected bars are
+    // filtered once, the slot map is compacted in one pass and the
+    // constraints are updated without a rebuild. Ids which don't
+    // exist or repeat are skipped without a warning. The masses of the
+    // joints are lumped again, as when the bars are destroyed one by one.
+    static void destroy(const std::vector<int>& obj_ids);
+    
+    // Removes all the bars
+    static void clear();
+    
     // Split the bar into n_parts bars of equal lengths.
     // The bar is removed in the process and completely
     // new bars are created.
     static void split(int bar_id, unsigned int n_parts);
     
-    void draw(const Renderer& rend) const;
-    
 private:
     // Equilibrium, unstressed length
     double r0;
     
-    // Between 0.0 and 1.0
-    double stiffness;
+    // Bars sharing a particle have different colours. Assigned
+    // when the bar is created.
+    unsigned int colour;
+    
+    // Index in the material table
+    unsigned char material;
     
+    double static_force;
+    double static_strain;
+    
+    // A bar with this strain between the particles. It isn't connected
+    // to them yet, create does that and lumps their masses.
     Bar(int id1, int id2, double e);
+    
+    // An unstrained bar which isn't connected yet
+    Bar();
 };
 
 void print_bars();
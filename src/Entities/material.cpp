@@ -0,0 +1,154 @@
+//
+//  material.cpp
+//  Trusses
+//
+
+#include "material.h"
+#include "particle.h"
+#include "bar.h"
+#include "constraint_table.h"
+#include <cmath>
+#include <sstream>
+
+MaterialTable materials;
+
+MaterialTable::MaterialTable()
+{
+    reset();
+}
+
+Material MaterialTable::get(unsigned int i) const
+{
+    Material m;
+    m.name = name[i];
+    m.modulus = modulus[i];
+    m.yield_strain = yield_strain[i];
+    m.density = density[i];
+    m.tension_limit = tension_limit[i];
+    m.compression_limit = compression_limit[i];
+    m.compliance = compliance[i];
+    return m;
+}
+
+int MaterialTable::find(const std::string& material_name) const
+{
+    for (unsigned int i = 0; i < size(); i++)
+        if (name[i] == material_name)
+            return i;
+    return -1;
+}
+
+int MaterialTable::set(const Material& material)
+{
+    int old = find(material.name);
+    double old_density = old != -1 ? density[old] : 0.0;
+    int i = store(material);
+    if (i == -1)
+        return -1;
+    
+    // Only the joints of the bars of this material get heavier or lighter
+    if (old != -1 && density[i] != old_density)
+    {
+        for (int j = 0; j < bars.size(); j++)
+        {
+            const Bar& b = bars.at(j);
+            if ((int)b.get_material() != i)
+                continue;
+            particles[b.p1_id].lump_mass();
+            particles[b.p2_id].lump_mass();
+        }
+    }
+    constraints.invalidate();
+    return i;
+}
+
+int MaterialTable::store(const Material& material)
+{
+    int i = find(material.name);
+    if (i == -1)
+    {
+        if (size() >= MAX_MATERIALS)
+            return -1;
+        i = size();
+        name.push_back(material.name);
+        modulus.push_back(0.0);
+        yield_strain.push_back(0.0);
+        density.push_back(0.0);
+        tension_limit.push_back(0.0);
+        compression_limit.push_back(0.0);
+        compliance.push_back(0.0);
+    }
+    modulus[i] = material.modulus;
+    yield_strain[i] = material.yield_strain;
+    density[i] = material.density;
+    tension_limit[i] = material.tension_limit;
+    compression_limit[i] = material.compression_limit;
+    compliance[i] = material.compliance;
+    return i;
+}
+
+int MaterialTable::legacy(double bar_compliance)
+{
+    for (unsigned int i = 0; i < size(); i++)
+        if (compliance[i] >= 0.0 && compliance[i] == bar_compliance)
+            return i;
+    
+    // The first one is just "legacy"
+    Material m;
+    m.name = "legacy";
+    for (int k = 1; find(m.name) != -1; k++)
+    {
+        std::ostringstream s;
+        s << "legacy" << k;
+        m.name = s.str();
+    }
+    m.modulus = bar_compliance > 0.0 ? 1.0 / bar_compliance : INFINITY;
+    m.yield_strain = 0.06;
+    m.density = 0.0;
+    m.tension_limit = 0.3;
+    m.compression_limit = 0.3;
+    m.compliance = bar_compliance;
+    return set(m);
+}
+
+void MaterialTable::reset()
+{
+    name.clear();
+    modulus.clear();
+    yield_strain.clear();
+    density.clear();
+    tension_limit.clear();
+    compression_limit.clear();
+    compliance.clear();
+    current = 0;
+    
+    // The compliance of a 1 m bar is 1e-7 m/N, it turns fully
+    // red at 6% strain and breaks at 30% either way
+    Material m;
+    m.compliance = -1.0;
+    m.name = "default";
+    m.modulus = 1e7;
+    m.yield_strain = 0.06;
+    m.density = 1.0;
+    m.tension_limit = 0.3;
+    m.compression_limit = 0.3;
+    store(m);
+    
+    // 200 GPa over 10 cm^2
+    m.name = "steel";
+    m.modulus = 2e8;
+    m.yield_strain = 0.002;
+    m.density = 7.85;
+    m.tension_limit = 0.05;
+    m.compression_limit = 0.05;
+    store(m);
+    
+    // 10 GPa over 100 cm^2, weaker in compression
+    m.name = "timber";
+    m.modulus = 1e8;
+    m.yield_strain = 0.004;
+    m.density = 5.0;
+    m.tension_limit = 0.01;
+    m.compression_limit = 0.006;
+    store(m);
+}
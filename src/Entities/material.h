@@ -0,0 +1,94 @@
+//
+//  material.h
+//  Trusses
+//
+
+#ifndef __Trusses__material__
+#define __Trusses__material__
+
+#include <string>
+#include <vector>
+
+// Bars refer to their material by an index stored in one byte
+#define MAX_MATERIALS 256
+
+// Compliance every bar had before there were materials
+#define LEGACY_COMPLIANCE 1e-7
+
+// Properties shared by the bars of one material. Bars are lines, so
+// the stiffness and the density are given per unit of length.
+struct Material
+{
+    std::string name;
+    
+    // Axial rigidity (Young's modulus times the cross-section area), in
+    // newtons. The compliance of a bar is its rest length divided by it.
+    double modulus;
+    
+    // Strain at which the material stops being elastic. Bars are
+    // coloured by how close their strain is to it.
+    double yield_strain;
+    
+    // Mass per metre, lumped into the joints at the ends of the bars
+    double density;
+    
+    // Strains (both positive) at which the bars break when
+    // stretched and when compressed
+    double tension_limit;
+    double compression_limit;
+    
+    // Compliance of every bar whatever its length (m/N), negative if it
+    // follows from the modulus. Only the materials of the scenes saved
+    // before there were materials have one (see MaterialTable::legacy).
+    double compliance;
+};
+
+// All the materials, one array per property, indexed by the material
+// index of the bars. The table starts with the built-in materials:
+// "default" (what every bar used to be), "steel" and "timber".
+class MaterialTable
+{
+public:
+    MaterialTable();
+    
+    std::vector<std::string> name;
+    std::vector<double> modulus;
+    std::vector<double> yield_strain;
+    std::vector<double> density;
+    std::vector<double> tension_limit;
+    std::vector<double> compression_limit;
+    std::vector<double> compliance;
+    
+    // Material of the bars created from now on
+    unsigned int current;
+    
+    unsigned int size() const {return (unsigned int)name.size();}
+    
+    Material get(unsigned int i) const;
+    
+    // Index of the material of this name, -1 if there is none
+    int find(const std::string& material_name) const;
+    
+    // Changes the material of the same name, or adds it if there is
+    // none. If its density changes, the masses of the joints of its bars
+    // are lumped again. Returns the index of the material, -1 if the
+    // table is full.
+    int set(const Material& material);
+    
+    // A material which behaves like the bars did before there were
+    // materials: this compliance whatever the length, no mass (so the
+    // joints weigh 1 kg), breaking at 30% strain. Added if there is none
+    // yet. Returns its index, -1 if the table is full.
+    int legacy(double bar_compliance);
+    
+    // Goes back to the built-in materials
+    void reset();
+
+private:
+    // Changes or adds the material without lumping the masses
+    int store(const Material& material);
+};
+
+extern MaterialTable materials;
+
+#endif /* defined(__Trusses__material__) */
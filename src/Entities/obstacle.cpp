@@ -8,12 +8,16 @@
 
 #include "obstacle.h"
 #include "particle.h"
-#include "renderer.h"
 #include "temporary_label.h"
 #include "segment.h"
+#include "spatial_hash.h"
+#include "various_math.h"
+#include <sstream>
 
 SlotMap<Obstacle> obstacles;
 
+double Obstacle::field_cell_size = 0.0;
+
 int Obstacle::create(const Polygon &poly)
 {
     if (poly.self_intersects())
@@ -30,80 +34,150 @@ Obstacle::Obstacle(const Polygon& poly)
     // Copy the points
     points = poly.points;
     update_bounding_box();
+    edges.build(points);
+    if (field_cell_size > 0.0)
+        build_field(field_cell_size);
     
     // Triangulate the polygon
     triangulate();
 }
 
-void Obstacle::draw(const Renderer& rend)
-{
-    rend.render(*this);
-}
-
 void Obstacle::update_bounding_box()
 {
     box_min = bounding_box_min();
     box_max = bounding_box_max();
 }
 
-void Obstacle::collide()
+void Obstacle::collide(const SpatialHash& grid)
 {
-    for (int i = 0; i < particles.size(); i++)
+    // Particles which moved far enough can reach the obstacle from outside its box
+    Vector2d margin(grid.max_displacement(), grid.max_displacement());
+    std::vector<int> candidates;
+    grid.query(box_min - margin, box_max + margin, candidates);
+    for (int j = 0; j < candidates.size(); j++)
+        collide(candidates[j]);
+}
+
+void Obstacle::build_field(double cell_size)
+{
+    field.build(edges, box_min, box_max, cell_size);
+    
+    // Walls thinner than the cells can be tunnelled through
+    if (!field.empty() && field.cell_size() > cell_size)
     {
-        Particle& p = particles.at(i);
-        
-        // Continue if the particle is fixed
-        if (p.fixed_)
-            continue;
-        
-        // Continue if the particle is away from the obstacle
-        Vector2d p_pos = p.position_;
-        if (p_pos.x < box_min.x || p_pos.x > box_max.x ||
-            p_pos.y < box_min.y || p_pos.y > box_max.y)
-            continue;
-        
-        // Continue if the particle isn't inside the polygon
-        if (!point_inside(p_pos))
-            continue;
+        std::stringstream s;
+        s << "Distance field coarsened to " << field.cell_size() << " m cells";
+        issue_label(s.str(), WARNING_LABEL_TIME);
+    }
+}
+
+void Obstacle::clear_field()
+{
+    field.clear();
+}
+
+int Obstacle::set_field(const std::vector<double>& numbers, double cell_size)
+{
+    if (numbers.size() < 3 || numbers[2] != DistanceField::sampled_cell_size(box_max - box_min, cell_size))
+        return 1;
+    return field.read(numbers);
+}
+
+const DistanceField& Obstacle::distance_field() const
+{
+    return field;
+}
+
+bool Obstacle::point_inside(const Vector2d& p) const
+{
+    return edges.point_inside(p);
+}
 
-        // The particle is inside the polygon. Find the intersection point.
-        // This is done by looping through all the edges of the polygon and computing
-        // the intersection of this edge with the segment representing the change in
-        // the particle's position (delta_p). The first intersection found is used.
-        Segment delta_p = Segment(p.prev_position_verlet_, p.position_);
-        bool intersected = false;
-        for (int i = 0; i < points.size() && !intersected; i++)
+bool Obstacle::overlaps(const Vector2d& min, const Vector2d& max) const
+{
+    return min.x <= box_max.x && max.x >= box_min.x &&
+           min.y <= box_max.y && max.y >= box_min.y;
+}
+
+void Obstacle::collide(unsigned int i)
+{
+    // Return if the particle is fixed or asleep
+    if (particle_store.fixed[i] || particle_store.sleeping[i])
+        return;
+    
+    Vector2d& position = particle_store.position[i];
+    Vector2d& prev_position = particle_store.prev_position[i];
+    
+    // Return if the path of the particle in this step is away from the obstacle
+    Vector2d path_min(min(position.x, prev_position.x), min(position.y, prev_position.y));
+    Vector2d path_max(max(position.x, prev_position.x), max(position.y, prev_position.y));
+    if (!overlaps(path_min, path_max))
+        return;
+    
+    // A distance field is accurate enough for the particles which moved
+    // less than a cell, and tells which ones can't have reached the boundary
+    double step_length = (position - prev_position).abs();
+    if (field.covers(position) && field.covers(prev_position))
+    {
+        if (field.distance(prev_position) > step_length + field.cell_size())
+            return;
+        if (step_length < field.cell_size())
         {
-            Segment edge = (i == 0) ? Segment(points.back(), points[0]) : Segment(points[i-1], points[i]);
-            
-            double t, u;
-            Vector2d intersection;
-            intersected = delta_p.intersect(edge, intersection, t, u);
-            
-            // Intersection found
-            if (intersected)
-            {
-                Vector2d edge_vect = edge.p1 - edge.p2;
-                Vector2d edge_normal = Vector2d(-edge_vect.y, edge_vect.x).norm();
-                
-                // Reflect the particle over the edge
-                Vector2d new_pos = p.position_.reflect(edge_normal, intersection);
-                Vector2d new_prev_pos = p.prev_position_verlet_.reflect(edge_normal, intersection);
-                
-                // If the particle is still inside the polygon after the reflection,
-                // it means that it probably bounced off the corner. In this case
-                // just reverse its velocity (i.e. the angle of reflection is equal
-                // to the angle of incidence).
-                // TODO: This angle should be defined by the angle bisector of the two
-                // near edges
-                if (point_inside(new_pos))
-                {
-                    new_pos = 2 * intersection - p.position_;
-                    new_prev_pos = 2 * intersection - p.prev_position_verlet_;
-                }
-                p.position_ = new_pos;
-                p.prev_position_verlet_ = new_prev_pos;
-            }
+            collide_field(position, prev_position);
+            return;
         }
     }
-}
\ No newline at end of file
+    
+    // Find the edge crossed first by the segment representing the change
+    // in the particle's position (delta_p). Checking the whole path rather
+    // than the final position stops fast particles going through thin walls.
+    Segment delta_p = Segment(prev_position, position);
+    int edge_id;
+    double t;
+    Vector2d intersection;
+    if (!edges.first_hit(delta_p, edge_id, intersection, t))
+        return;
+    
+    // The particle started inside and is on its way out
+    if (point_inside(prev_position))
+        return;
+    
+    Segment edge = edges.edge(edge_id);
+    Vector2d edge_vect = edge.p1 - edge.p2;
+    Vector2d edge_normal = Vector2d(-edge_vect.y, edge_vect.x).norm();
+    
+    // Reflect the particle over the edge
+    Vector2d new_pos = position.reflect(edge_normal, intersection);
+    Vector2d new_prev_pos = prev_position.reflect(edge_normal, intersection);
+    
+    // If the particle is still inside the polygon after the reflection,
+    // it means that it probably bounced off the corner. In this case
+    // just reverse its velocity (i.e. the angle of reflection is equal
+    // to the angle of incidence).
+    // TODO: This angle should be defined by the angle bisector of the two
+    // near edges
+    if (point_inside(new_pos))
+    {
+        new_pos = 2 * intersection - position;
+        new_prev_pos = 2 * intersection - prev_position;
+    }
+    position = new_pos;
+    prev_position = new_prev_pos;
+}
+
+void Obstacle::collide_field(Vector2d& position, Vector2d& prev_position) const
+{
+    double d = field.distance(position);
+    if (d >= 0.0)
+        return;
+    
+    Vector2d normal = field.gradient(position).norm();
+    if (normal.abs2() == 0.0)
+        return;
+    
+    // Reflect the particle over the tangent at the closest point of
+    // the boundary. The gradient is smooth, so corners need no special case.
+    Vector2d contact = position - d * normal;
+    position = position.reflect(normal, contact);
+    prev_position = prev_position.reflect(normal, contact);
+}
@@ -11,9 +11,12 @@
 
 #include <stdio.h>
 #include "polygon.h"
+#include "edge_tree.h"
+#include "distance_field.h"
 #include "slot_map.h"
 
 class Renderer;
+class SpatialHash;
 
 class Obstacle: public Polygon
 {
@@ -21,17 +24,54 @@ class Obstacle: public Polygon
 public:
     static int create(const Polygon& poly);
     int id_;
-    void draw(const Renderer& rend);
-    // Handle the collisions with the particles
-    void collide();
+    // Handle the collisions with the particles of the grid
+    // which are inside the bounding box
+    void collide(const SpatialHash& grid);
+    
+    // Handle the collision with the particle at index i of particle_store.
+    // Checks the whole path of the particle in the last step, so the
+    // particle can't pass through the obstacle in one step.
+    void collide(unsigned int i);
+    
+    // True if the bounding box of the obstacle overlaps the given box
+    bool overlaps(const Vector2d& min, const Vector2d& max) const;
+    
+    // True if the point is inside the obstacle. Uses the edge tree
+    // instead of walking all the edges like Polygon::point_inside.
+    bool point_inside(const Vector2d& p) const;
+    
+    // Cell size of the signed distance fields built for new obstacles,
+    // zero if they collide using their edges
+    static double field_cell_size;
+    
+    // With a distance field, particles are pushed out along its gradient
+    // instead of being reflected over the edge they crossed. Large
+    // obstacles get coarser cells (see MAX_FIELD_SAMPLES), with a warning.
+    void build_field(double cell_size);
+    void clear_field();
+    
+    // Uses a field read from a file (see DistanceField::read), if it
+    // has the cells build_field would give it for this cell size.
+    // Returns 0 on success.
+    int set_field(const std::vector<double>& numbers, double cell_size);
+    
+    const DistanceField& distance_field() const;
     
 protected:
     Vector2d box_min;
     Vector2d box_max;
     
+    // Obstacles don't change after they are created,
+    // so the tree is built once
+    EdgeTree edges;
+    DistanceField field;
+    
 private:
     Obstacle(const Polygon& poly);
     void update_bounding_box();
+    
+    // Collision of a particle inside the area covered by the field
+    void collide_field(Vector2d& position, Vector2d& prev_position) const;
 };
 
 extern SlotMap<Obstacle> obstacles;
@@ -9,72 +9,160 @@
 #include "particle.h"
 #include "bar.h"
 #include "temporary_label.h"
-#include "renderer.h"
 #include "game.h"
 #include "settings.h"
+#include "constraint_table.h"
+#include "islands.h"
 
 SlotMap<Particle> particles;
 const double g = 9.81;
 
 int Particle::create(double a, double b, bool fixed)
 {
-    return particles.add(Particle(a, b, fixed));
+    int new_id = particles.add(Particle());
+    particle_store.add(Vector2d(a, b), fixed);
+    constraints.invalidate();
+    islands.invalidate();
+    return new_id;
 }
 
-Particle::Particle(double a, double b, bool fixed): trace_points(300)
+void Particle::create(const std::vector<Vector2d>& positions,
+                      const std::vector<char>& fixed, std::vector<int>& new_ids)
 {
-    position_ = Vector2d(a, b);
-    velocity_ = Vector2d(0.0, 0.0);
-    double dt = game.dt_s();
-    prev_position_ = position_ - dt * velocity_;
-    prev_position_verlet_ = position_ - dt * velocity_;
-    acceleration_ = Vector2d(0.0, 0.0);
-    external_acceleration_ = Vector2d(0.0, 0.0);
-    mass_ = 1.0;
-    fixed_ = (fixed) ? true : false;
-    trace_enabled = false;
+    unsigned int n = particles.size() + (unsigned int)positions.size();
+    particles.reserve(n);
+    particle_store.reserve(n);
+    new_ids.reserve(new_ids.size() + positions.size());
+    
+    Particle prototype;
+    for (int i = 0; i < positions.size(); i++)
+    {
+        new_ids.push_back(particles.add(prototype));
+        particle_store.add(positions[i], fixed[i]);
+    }
+    constraints.invalidate();
+    islands.invalidate();
+}
+
+Particle::Particle(): trace_points(300) {}
+
+unsigned int Particle::index() const
+{
+    return particles.index(id_);
+}
+
+Vector2d& Particle::position()
+{
+    return particle_store.position[index()];
+}
+
+const Vector2d& Particle::position() const
+{
+    return particle_store.position[index()];
+}
+
+Vector2d& Particle::prev_position()
+{
+    return particle_store.prev_position[index()];
+}
+
+const Vector2d& Particle::prev_position() const
+{
+    return particle_store.prev_position[index()];
+}
+
+double Particle::mass() const
+{
+    return 1.0 / particle_store.inv_mass[index()];
+}
+
+void Particle::set_mass(double m)
+{
+    particle_store.inv_mass[index()] = 1.0 / m;
+    wake();
+    constraints.invalidate();
+}
+
+void Particle::lump_mass()
+{
+    double m = 0.0;
+    for (int i = 0; i < bars_connected.size(); i++)
+        m += 0.5 * bars[bars_connected[i]].mass();
+    particle_store.inv_mass[index()] = m > 0.0 ? 1.0 / m : 1.0;
+}
+
+void Particle::set_external_acceleration(const Vector2d& a)
+{
+    particle_store.acceleration[index()] = a;
+    if (a.abs2() > 0.0)
+        wake();
+}
+
+bool Particle::fixed() const
+{
+    return particle_store.fixed[index()];
+}
+
+void Particle::set_fixed(bool state)
+{
+    wake();
+    particle_store.fixed[index()] = state;
+    constraints.invalidate();
+    islands.invalidate();
+}
+
+void Particle::wake()
+{
+    islands.wake(index());
+    
+    // Fixed particles belong to no island, so wake up their neighbours
+    if (fixed())
+    {
+        for (int i = 0; i < bars_connected.size(); i++)
+        {
+            const Bar& b = bars[bars_connected[i]];
+            islands.wake(particles.index(b.p1_id == id_ ? b.p2_id : b.p1_id));
+        }
+    }
 }
 
 void Particle::trace()
 {
-    trace_enabled = true;
+    particle_store.traced[index()] = true;
 }
 
 void Particle::untrace()
 {
-    trace_enabled = false;
+    particle_store.traced[index()] = false;
     trace_points.clear();
 }
 
 bool Particle::traced() const
 {
-    return trace_enabled;
+    return particle_store.traced[index()];
 }
 
-void Particle::update()
+void Particle::update_all()
 {
-    if (!fixed_)
-    {
-        // External acceleration is the acceleration added by dragging with a mouse
-        acceleration_ = external_acceleration_;
-        
-        // Remember the presious position
-        prev_position_ = position_;
-        
-        // Trace the previous position
-        if (trace_enabled)
-            trace_points.add(position_);
-        
-        if (settings.get(GRAVITY))
-            acceleration_ += Vector2d(0.0, -g);
-        
-        // Verlet integration
-        double dt = game.dt_s();
-        Vector2d next_position = 2 * position_ - prev_position_verlet_ + pow(dt, 2) * acceleration_;
-        velocity_ = (0.5 / dt) * (next_position - prev_position_);
-        prev_position_verlet_ = position_;
-        position_ = next_position;
-    }
+    // Trace the previous positions
+    record_traces();
+    
+    // Verlet integration
+    particle_store.integrate(game.dt_s(), gravity());
+}
+
+void Particle::record_traces()
+{
+    for (int i = 0; i < particle_store.size(); i++)
+        if (particle_store.traced[i] && !particle_store.fixed[i])
+            particles.at(i).trace_points.add(particle_store.position[i]);
+}
+
+Vector2d Particle::gravity()
+{
+    if (settings.get(GRAVITY))
+        return Vector2d(0.0, -g);
+    return Vector2d(0.0, 0.0);
 }
 
 void print_particles()
@@ -105,11 +193,39 @@ int Particle::destroy(int obj_id)
     for (int i = 0; i < no_bars_connected; i++)
         Bar::destroy(this_p.bars_connected.back());
     
+    particle_store.remove(particles.index(obj_id));
     int result = particles.remove(obj_id);
+    constraints.invalidate();
+    islands.invalidate();
     return result;
 }
 
-void Particle::draw(const Renderer& rend) const
+void Particle::destroy(const std::vector<int>& removed_ids)
+{
+    std::vector<int> connected_bars;
+    for (int i = 0; i < removed_ids.size(); i++)
+    {
+        if (!particles.exists(removed_ids[i]))
+            continue;
+        const std::vector<int>& connected = particles[removed_ids[i]].bars_connected;
+        connected_bars.insert(connected_bars.end(), connected.begin(), connected.end());
+    }
+    Bar::destroy(connected_bars);
+    
+    // The store repeats the moves made by the slot map
+    std::vector<unsigned int> positions;
+    particles.remove(removed_ids, positions);
+    if (positions.empty())
+        return;
+    particle_store.remove(positions);
+    constraints.invalidate();
+    islands.invalidate();
+}
+
+void Particle::clear()
 {
-    rend.render(*this);
+    particles.clear();
+    particle_store.clear();
+    constraints.invalidate();
+    islands.invalidate();
 }
\ No newline at end of file
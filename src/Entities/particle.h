@@ -13,6 +13,7 @@
 #include "vector2d.h"
 #include "slot_map.h"
 #include "fixed_size.h"
+#include "particle_store.h"
 
 class Renderer;
 class Bar;
@@ -21,49 +22,88 @@ class Particle
 {
     friend class Renderer;
     friend class Bar;
+    friend class SimulationThread;
+    friend class Journal;
     friend void print_particles();
 public:
     // Unique id of the particle
     int id_;
     
-    // Needed by the simulation
-    Vector2d position_;
-    Vector2d prev_position_;
-    Vector2d prev_position_verlet_;
-    Vector2d velocity_;
-    Vector2d acceleration_;
-    double mass_;
+    // Position of the particle's state in particle_store
+    unsigned int index() const;
+    
+    // The state needed by the simulation lives in particle_store.
+    // These accessors are meant for the editor and the interface,
+    // the simulation loops use the store directly.
+    Vector2d& position();
+    const Vector2d& position() const;
+    
+    // Position in the previous step of Verlet integration
+    Vector2d& prev_position();
+    const Vector2d& prev_position() const;
+    
+    // The mass is lumped from the bars (see lump_mass), set_mass
+    // overrides it until the bars of the particle or the density
+    // of their material change
+    double mass() const;
+    void set_mass(double m);
+    
+    // Sets the mass to half the mass of each connected bar, or to 1 kg
+    // if there are none. Called whenever the bars of the particle are
+    // created, deleted (also by fractures) or changed in the editor.
+    // The constraint table keeps the old mass until the caller
+    // invalidates it or removes bars from it (see remove_bars).
+    void lump_mass();
     
     // Added by dragging the particle
-    // TODO: Merge it with acceleration_
-    Vector2d external_acceleration_;
+    void set_external_acceleration(const Vector2d& a);
     
     // If true the particle doesn't move.
-    bool fixed_;
+    bool fixed() const;
+    void set_fixed(bool state);
+    
+    // Wakes up the island of the particle (see Islands). Should be
+    // called when the particle is moved from outside the simulation.
+    void wake();
     
     // For tracing the path of the particle.
     void trace();
     void untrace();
     bool traced() const;
     
-    // Numerical simulation.
-    void update();
+    // Numerical simulation of all the particles.
+    static void update_all();
     
-    virtual void draw(const Renderer& rend) const;
+    // Adds the current positions to the traces
+    static void record_traces();
+    
+    // Acceleration due to gravity, zero if gravity is off
+    static Vector2d gravity();
     
     // Remove a particle with this id
     static int destroy(int removed_id);
+    
+    // Destroys the particles and their bars together (see
+    // Bar::destroy). Ids which don't exist are skipped.
+    static void destroy(const std::vector<int>& removed_ids);
 
     static int create(double a, double b, bool fixed);
     
+    // Creates the particles together and appends their ids to new_ids.
+    // Particle k is fixed if fixed[k] is non-zero.
+    static void create(const std::vector<Vector2d>& positions,
+                       const std::vector<char>& fixed, std::vector<int>& new_ids);
+    
+    // Removes all the particles
+    static void clear();
+    
 private:
-    Particle(double a, double b, bool fixed);
+    Particle();
     
     // id's of all the bars connected to this particle
     std::vector<int> bars_connected;
     
     FixedSizeContainer<Vector2d> trace_points;
-    bool trace_enabled;
 };
 
 void print_particles();
@@ -0,0 +1,109 @@
+//
+//  particle_store.cpp
+//  Trusses
+//
+
+#include "particle_store.h"
+
+ParticleStore particle_store;
+
+void ParticleStore::add(const Vector2d& pos, bool is_fixed)
+{
+    position.push_back(pos);
+    prev_position.push_back(pos);
+    acceleration.push_back(Vector2d(0.0, 0.0));
+    inv_mass.push_back(1.0);
+    fixed.push_back(is_fixed);
+    traced.push_back(false);
+    sleeping.push_back(false);
+}
+
+void ParticleStore::reserve(unsigned int n)
+{
+    position.reserve(n);
+    prev_position.reserve(n);
+    acceleration.reserve(n);
+    inv_mass.reserve(n);
+    fixed.reserve(n);
+    traced.reserve(n);
+    sleeping.reserve(n);
+}
+
+void ParticleStore::remove(unsigned int i)
+{
+    position[i] = position.back();
+    prev_position[i] = prev_position.back();
+    acceleration[i] = acceleration.back();
+    inv_mass[i] = inv_mass.back();
+    fixed[i] = fixed.back();
+    traced[i] = traced.back();
+    sleeping[i] = sleeping.back();
+    
+    position.pop_back();
+    prev_position.pop_back();
+    acceleration.pop_back();
+    inv_mass.pop_back();
+    fixed.pop_back();
+    traced.pop_back();
+    sleeping.pop_back();
+}
+
+void ParticleStore::remove(const std::vector<unsigned int>& indices)
+{
+    for (unsigned int j = 0; j < indices.size(); j++)
+        remove(indices[j]);
+}
+
+void ParticleStore::clear()
+{
+    position.clear();
+    prev_position.clear();
+    acceleration.clear();
+    inv_mass.clear();
+    fixed.clear();
+    traced.clear();
+    sleeping.clear();
+}
+
+void ParticleStore::integrate(double dt, const Vector2d& gravity)
+{
+    const Real dt2 = dt * dt;
+    const size_t n = position.size();
+    Vector2d* pos = position.data();
+    Vector2d* prev = prev_position.data();
+    const Vector2d* acc = acceleration.data();
+    const char* fix = fixed.data();
+    const char* asleep = sleeping.data();
+    
+    for (size_t i = 0; i < n; i++)
+    {
+        if (fix[i] || asleep[i])
+            continue;
+        
+        Vector2d next = 2 * pos[i] - prev[i] + dt2 * (acc[i] + gravity);
+        prev[i] = pos[i];
+        pos[i] = next;
+    }
+}
+
+void ParticleStore::integrate(double dt, const Vector2d& gravity,
+                              const int* indices, unsigned int count)
+{
+    const Real dt2 = dt * dt;
+    Vector2d* pos = position.data();
+    Vector2d* prev = prev_position.data();
+    const Vector2d* acc = acceleration.data();
+    const char* fix = fixed.data();
+    const char* asleep = sleeping.data();
+    
+    for (unsigned int j = 0; j < count; j++)
+    {
+        int i = indices[j];
+        if (fix[i] || asleep[i])
+            continue;
+        
+        Vector2d next = 2 * pos[i] - prev[i] + dt2 * (acc[i] + gravity);
+        prev[i] = pos[i];
+        pos[i] = next;
+    }
+}
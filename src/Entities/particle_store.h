@@ -0,0 +1,69 @@
+//
+//  particle_store.h
+//  Trusses
+//
+
+#ifndef __Trusses__particle_store__
+#define __Trusses__particle_store__
+
+#include <vector>
+#include "vector2d.h"
+
+// Simulation state of all the particles kept in contiguous arrays,
+// so that the integration loop only touches the data it needs.
+// Index i of every array refers to the particle stored at position i
+// of the particles slot map (see SlotMap::index). Particle::create and
+// Particle::destroy keep both containers in the same order.
+class ParticleStore
+{
+public:
+    std::vector<Vector2d> position;
+    
+    // Position in the previous step (used by Verlet integration)
+    std::vector<Vector2d> prev_position;
+    
+    // Acceleration added by dragging the particle
+    std::vector<Vector2d> acceleration;
+    
+    std::vector<Real> inv_mass;
+    
+    // Non-zero if the particle doesn't move
+    std::vector<char> fixed;
+    
+    // Non-zero if the path of the particle is traced. Not used
+    // by the integration.
+    std::vector<char> traced;
+    
+    // Non-zero if the particle belongs to a sleeping island (see
+    // Islands). Sleeping particles are skipped like fixed ones.
+    std::vector<char> sleeping;
+    
+    // Appends a particle at rest
+    void add(const Vector2d& pos, bool is_fixed);
+    
+    // Makes room for n particles in total
+    void reserve(unsigned int n);
+    
+    // Removes the particle at index i by moving the last particle
+    // in its place, the same way SlotMap::remove does.
+    void remove(unsigned int i);
+    
+    // Removes the particles at the given indices one after another,
+    // in the order given by SlotMap::remove for several objects
+    void remove(const std::vector<unsigned int>& indices);
+    
+    void clear();
+    
+    unsigned int size() const {return (unsigned int)position.size();}
+    
+    // Verlet integration of all the free, awake particles
+    void integrate(double dt, const Vector2d& gravity);
+    
+    // Verlet integration of the particles at the given indices
+    void integrate(double dt, const Vector2d& gravity,
+                   const int* indices, unsigned int count);
+};
+
+extern ParticleStore particle_store;
+
+#endif /* defined(__Trusses__particle_store__) */
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <utility>
 
 template <typename T>
 class SlotMap
@@ -41,11 +42,28 @@ public:
     const T& at(unsigned int i) const;
     int add(const T& new_object); // Adds a new object to the container.
     int add();
+    void reserve(unsigned int n); // Makes room for n objects in total, so that adding them doesn't reallocate
     int remove(int obj_id); // Removes object of this id from the container
+    
+    // Removes the objects of these ids together, skipping the ids which don't
+    // exist. Fills positions with the container positions that were freed, in
+    // the order they were filled by the last object, so that containers kept
+    // in the same order can repeat the removal (see ParticleStore::remove).
+    void remove(const std::vector<int>& obj_ids, std::vector<unsigned int>& positions);
     void clear();
     void print() const; // Prints all the objects together with the internal state of the slot map
     bool exists(int obj_id) const; // True if the objects exists in the container, false otherwise
+    int index(int obj_id) const; // Position of the object in the container, -1 if it doesn't exist
     unsigned int size() const {return (unsigned int)container.size();}
+    
+    // Ids which will be given to the next objects, the last one first
+    const std::vector<unsigned int>& unused_ids() const {return free_ids;}
+    
+    // Gives the objects new ids, ids[i] to the object at position i, and
+    // hands out these free ids next, so that the ids of another slot map
+    // can be copied (see Journal). Returns 1 and changes nothing if the
+    // ids repeat or some id is neither used nor free.
+    int set_ids(const std::vector<int>& ids, const std::vector<unsigned int>& new_free_ids);
     template <class U>
     friend std::ostream& operator<< (std::ostream& out, const SlotMap<U>& map);
 private:
@@ -130,6 +148,13 @@ int SlotMap<T>::add()
     return new_id;
 }
 
+template <typename T>
+void SlotMap<T>::reserve(unsigned int n)
+{
+    container.reserve(n);
+    slots.reserve(n);
+}
+
 template <typename T>
 int SlotMap<T>::remove(int obj_id)
 {
@@ -146,10 +171,10 @@ int SlotMap<T>::remove(int obj_id)
     int swapped_obj_id = container.back().id_; // Remember the id of the last object
     int removed_object_pos = slots[obj_id]; // Position of the object in the container
     
-    // Swap the object being destroyed with the last one
-    T last_copy = container.back();
-    container.back() = container[slots[obj_id]];
-    container[removed_object_pos] = last_copy;
+    // Move the last object in place of the one being destroyed,
+    // so that its members don't have to be copied
+    if (removed_object_pos != (int)container.size() - 1)
+        container[removed_object_pos] = std::move(container.back());
     
     // Pop the last object
     container.pop_back();
@@ -164,6 +189,66 @@ int SlotMap<T>::remove(int obj_id)
     return 0;
 }
 
+template <typename T>
+void SlotMap<T>::remove(const std::vector<int>& obj_ids, std::vector<unsigned int>& positions)
+{
+    positions.clear();
+    std::vector<char> removed(container.size(), false);
+    for (int i = 0; i < obj_ids.size(); i++)
+        if (exists(obj_ids[i]))
+            removed[slots[obj_ids[i]]] = true;
+    
+    // Filling the highest positions first means that the last object
+    // is never one which is about to be removed
+    for (unsigned int pos = (unsigned int)container.size(); pos > 0; pos--)
+        if (removed[pos - 1])
+            positions.push_back(pos - 1);
+    
+    for (int i = 0; i < positions.size(); i++)
+    {
+        unsigned int pos = positions[i];
+        int removed_id = container[pos].id_;
+        if (pos != container.size() - 1)
+        {
+            container[pos] = std::move(container.back());
+            slots[container[pos].id_] = pos;
+        }
+        container.pop_back();
+        slots[removed_id] = -1;
+        free_ids.push_back(removed_id);
+    }
+}
+
+template <typename T>
+int SlotMap<T>::set_ids(const std::vector<int>& ids, const std::vector<unsigned int>& new_free_ids)
+{
+    if (ids.size() != container.size())
+        return 1;
+    
+    int n_slots = (int)(ids.size() + new_free_ids.size());
+    std::vector<int> new_slots(n_slots, -1);
+    std::vector<char> free(n_slots, false);
+    for (int i = 0; i < ids.size(); i++)
+    {
+        if (ids[i] < 0 || ids[i] >= n_slots || new_slots[ids[i]] != -1)
+            return 1;
+        new_slots[ids[i]] = i;
+    }
+    for (int i = 0; i < new_free_ids.size(); i++)
+    {
+        unsigned int id = new_free_ids[i];
+        if (id >= n_slots || new_slots[id] != -1 || free[id])
+            return 1;
+        free[id] = true;
+    }
+    
+    for (int i = 0; i < ids.size(); i++)
+        container[i].id_ = ids[i];
+    slots.swap(new_slots);
+    free_ids = new_free_ids;
+    return 0;
+}
+
 // Returns -1 if the object doesn't exist
 template <typename T>
 unsigned int SlotMap<T>::locate(int obj_id) const
@@ -186,6 +271,14 @@ bool SlotMap<T>::exists(int obj_id) const
     return true;
 }
 
+template <typename T>
+int SlotMap<T>::index(int obj_id) const
+{
+    if (exists(obj_id))
+        return slots[obj_id];
+    return -1;
+}
+
 // Responsibility of the user to ensure that this object exists in the container
 template <typename T>
 const T& SlotMap<T>::operator[] (unsigned int obj_id) const
@@ -202,7 +295,7 @@ T& SlotMap<T>::operator[] (unsigned int obj_id)
     int obj_location = locate(obj_id);
     if (obj_location == -1)
         throw std::out_of_range("object does not exist");
-    return container[locate(obj_id)];
+    return container[obj_location];
 }
 
 template <typename T>
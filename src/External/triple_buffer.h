@@ -0,0 +1,59 @@
+//
+//  triple_buffer.h
+//  Trusses
+//
+
+#ifndef __Trusses__triple_buffer__
+#define __Trusses__triple_buffer__
+
+#include <atomic>
+
+// Passes the latest value from one writing thread to one reading thread
+// without locks. The writer fills the back buffer and publishes it, the
+// reader takes the most recently published buffer. Neither of them ever
+// waits for the other: values published faster than they are read are
+// skipped, and the reader keeps its value until a newer one is published.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer(): middle(1), back_index(0), front_index(2) {}
+    
+    // Buffer filled by the writer. It keeps its contents from the
+    // last time it was used, so that they can be overwritten in place.
+    T& back() {return buffers[back_index];}
+    
+    // Makes the back buffer the latest value and takes a free buffer
+    // as the new back buffer
+    void publish()
+    {
+        back_index = middle.exchange(back_index | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+    
+    // Takes the latest published value if there is one the reader hasn't
+    // seen yet. Returns true if the front buffer changed.
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front_index = middle.exchange(front_index, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    
+    // Value seen by the reader
+    const T& front() const {return buffers[front_index];}
+
+private:
+    // The middle buffer index is marked fresh until the reader takes it
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+    
+    T buffers[3];
+    std::atomic<int> middle;
+    
+    // Only used by the writer and by the reader respectively
+    int back_index;
+    int front_index;
+};
+
+#endif /* defined(__Trusses__triple_buffer__) */
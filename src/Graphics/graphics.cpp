@@ -29,11 +29,19 @@
 #include "game.h"
 #include "grid.h"
 #include "settings.h"
+#include "profiler.h"
+#include "timeline.h"
+#include "simulation_thread.h"
+
+// Width of the profile overlay in the bottom right corner (in px)
+#define PROFILE_OVERLAY_WIDTH 180
 
 // * * * * * * * * * * //
 void glut_print (float x, float y, std::string s);
 void display_fps(double dt);
 void display_time();
+void display_iterations();
+void display_profile();
 void draw_vector(Vector2d v, Vector2d start, float r, float g, float b);
 void draw_command_line();
 void draw_rectangle(Vector2d p1, Vector2d p2, bool filled);
@@ -58,19 +66,50 @@ void display_fps(double dt)
     
     std::ostringstream s;
     s << "fps: " << int(1/dt);
-    glut_print(-1 + px_to_ui_x(30), -1 + px_to_ui_y(20), s.str());
+    glut_print(1 - px_to_ui_x(PROFILE_OVERLAY_WIDTH), -1 + px_to_ui_y(BOTTOM_MARGIN + 16 * PROFILE_PHASES), s.str());
 }
 
 void display_time()
 {
     glColor3f(WHITE);
     
+    double time_s = simulation_thread.running() ? simulation_thread.snapshot().simulation_time_s : game.simulation_time_s();
     std::ostringstream s;
     s.precision(1);
-    s << "Time: " << std::fixed << game.simulation_time_s() << " s";
+    s << "Time: " << std::fixed << time_s << " s";
+    if (game.fast_forward())
+        s << " (fast-forward)";
     glut_print(0, -1 + px_to_ui_y(BOTTOM_MARGIN), s.str());
 }
 
+void display_iterations()
+{
+    glColor3f(WHITE);
+    
+    int iterations = simulation_thread.running() ? simulation_thread.snapshot().iterations : game.iterations_last_frame();
+    std::ostringstream s;
+    s << "Iterations: " << iterations;
+    glut_print(0, -1 + px_to_ui_y(BOTTOM_MARGIN + 20), s.str());
+}
+
+// Average time of each phase over the last frames, below the fps
+void display_profile()
+{
+    display_fps(game.frame_dt_s());
+    
+    std::ostringstream s;
+    s.precision(2);
+    s << std::fixed;
+    for (int i = 0; i < PROFILE_PHASES; i++)
+    {
+        s.str("");
+        s << Profiler::phase_name((ProfilePhase)i) << ": "
+          << profiler.average_ms((ProfilePhase)i) << " ms";
+        int row = PROFILE_PHASES - 1 - i;
+        glut_print(1 - px_to_ui_x(PROFILE_OVERLAY_WIDTH), -1 + px_to_ui_y(BOTTOM_MARGIN + 16 * row), s.str());
+    }
+}
+
 void draw_vector(Vector2d v, Vector2d start, float r, float g, float b)
 {
     Vector2d end = start + v;
@@ -180,6 +219,8 @@ void draw_horizon()
 // * * * * * * * * * * //
 void display()
 {
+    TraceSpan span("display");
+    
     // Clear the window
     glClear(GL_COLOR_BUFFER_BIT);
     glMatrixMode(GL_MODELVIEW);
@@ -189,44 +230,83 @@ void display()
     glLoadIdentity();
     gluOrtho2D(WORLD_VIEW);
     
+    // While the simulation thread runs, the structure
+    // is drawn as it was when last published
+    bool threaded = simulation_thread.running();
+    if (threaded)
+        simulation_thread.update_snapshot();
+    
     if (!game.simulation_running())
+    {
+        ScopedTimer timer(PHASE_RENDER_GRID);
         renderer.render(grid);
+    }
     
     // Draw the obstacles
-    for (int i = 0; i < obstacles.size(); i++)
-        obstacles.at(i).draw(renderer);
+    {
+        ScopedTimer timer(PHASE_RENDER_OBSTACLES);
+        for (int i = 0; i < obstacles.size(); i++)
+            renderer.render(obstacles.at(i));
+    }
     
     // Draw the particles
-    for (int i = 0; i < particles.size(); i++)
-        particles.at(i).draw(renderer);
+    {
+        ScopedTimer timer(PHASE_RENDER_PARTICLES);
+        if (threaded)
+            renderer.render_particles(simulation_thread.snapshot());
+        else
+            for (int i = 0; i < particles.size(); i++)
+                renderer.render(particles.at(i));
+    }
     
     // Draw the bars
-    for (int i = 0; i < bars.size(); i++)
-        bars.at(i).draw(renderer);
+    {
+        ScopedTimer timer(PHASE_RENDER_BARS);
+        if (threaded)
+            renderer.render_bars(simulation_thread.snapshot());
+        else
+            for (int i = 0; i < bars.size(); i++)
+                renderer.render(bars.at(i));
+    }
     
     // Draw the tool-specific things
-    current_tool->display(renderer);
+    {
+        ScopedTimer timer(PHASE_RENDER_TOOL);
+        current_tool->display(renderer);
+    }
     
     // Switch to the UI view
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluOrtho2D(UI_VIEW);
     
-    // Draw temporary labels
-    for (int i = 0; i < temp_labels.size(); i++)
-        temp_labels.at(i).draw(renderer);
-    
-    // Draw buttons
-    for (int i = 0; i < buttons.size(); i++)
-        buttons[i].draw(renderer);
-    
-    display_time();
-    
-    // Draw the command line
-    if (command_mode)
-        draw_command_line();
+    {
+        ScopedTimer timer(PHASE_RENDER_UI);
+        
+        // Draw temporary labels
+        for (int i = 0; i < temp_labels.size(); i++)
+            renderer.render(temp_labels.at(i));
+        
+        // Draw buttons
+        for (int i = 0; i < buttons.size(); i++)
+            buttons[i].draw(renderer);
+        
+        display_time();
+        if (game.simulation_running())
+            display_iterations();
+        if (profiler.enabled)
+            display_profile();
+        
+        // Draw the command line
+        if (command_mode)
+            draw_command_line();
+    }
     
-    glutSwapBuffers();
+    {
+        TraceSpan swap_span("swap buffers");
+        glutSwapBuffers();
+    }
+    profiler.end_frame();
 }
 
 void reshape(int width, int height)
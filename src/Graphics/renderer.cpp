@@ -19,6 +19,7 @@
 #include "graphics.h"
 #include "particle.h"
 #include "bar.h"
+#include "material.h"
 #include "obstacle.h"
 #include "temporary_label.h"
 #include "button.h"
@@ -35,31 +36,66 @@
 #include "mouse.h"
 #include "interface.h"
 #include "various_math.h"
+#include "simulation_thread.h"
 
 void Renderer::render(const Particle& obj) const
 {
     // Draw the trace if it is enabled
     if (obj.traced())
     {
-        glLineWidth(1);
-        glBegin(GL_LINE_STRIP);
-        size_t size = obj.trace_points.size();
-        double quad_coeff = -1.0/(size*size);
-        for (int i = 0; i < size; i++)
-        {
-            // Quadratic fade out
-            glColor4f(GOLD, quad_coeff*(size-i)*(size-1) + 1);
-            Vector2d t = obj.trace_points.get(i);
-            glVertex2f(t.x, t.y);
-        }
-        glEnd();
+        std::vector<Vector2d> trace(obj.trace_points.size());
+        for (int i = 0; i < trace.size(); i++)
+            trace[i] = obj.trace_points.get(i);
+        render_trace(trace.data(), trace.size());
     }
     
-    // Particle's position
-    Vector2d pos = obj.position_;
+    render_particle(obj.position(), obj.fixed(), obj.id_);
+}
+
+void Renderer::render(const Bar& obj) const
+{
+    render_bar(particles[obj.p1_id].position(), particles[obj.p2_id].position(),
+               obj.get_strain(), materials.yield_strain[obj.get_material()], obj.id_);
+}
+
+void Renderer::render_particles(const WorldSnapshot& obj) const
+{
+    for (int i = 0; i < obj.trace_particle.size(); i++)
+    {
+        size_t start = obj.trace_start[i];
+        size_t end = i + 1 < obj.trace_start.size() ? obj.trace_start[i+1] : obj.trace_points.size();
+        render_trace(obj.trace_points.data() + start, end - start);
+    }
     
+    for (int i = 0; i < obj.position.size(); i++)
+        render_particle(obj.position[i], obj.fixed[i], obj.particle_id[i]);
+}
+
+void Renderer::render_bars(const WorldSnapshot& obj) const
+{
+    for (int i = 0; i < obj.bar_id.size(); i++)
+        render_bar(obj.position[obj.bar_p1[i]], obj.position[obj.bar_p2[i]],
+                   obj.bar_strain[i], materials.yield_strain[obj.bar_material[i]], obj.bar_id[i]);
+}
+
+void Renderer::render_trace(const Vector2d* points, size_t size) const
+{
+    glLineWidth(1);
+    glBegin(GL_LINE_STRIP);
+    double quad_coeff = -1.0/(size*size);
+    for (int i = 0; i < size; i++)
+    {
+        // Quadratic fade out
+        glColor4f(GOLD, quad_coeff*(size-i)*(size-1) + 1);
+        glVertex2f(points[i].x, points[i].y);
+    }
+    glEnd();
+}
+
+void Renderer::render_particle(const Vector2d& pos, bool fixed, int id) const
+{
     // If fixed
-    if (obj.fixed_)
+    if (fixed)
     {
         double one_px_in_m = px_to_m(1);
         
@@ -86,7 +122,7 @@ void Renderer::render(const Particle& obj) const
     if (settings.get(IDS))
     {
         std::stringstream s;
-        s << obj.id_;
+        s << id;
         
         // Add 5 pixels in eah direction
         glColor3f(GOLD);
@@ -94,24 +130,21 @@ void Renderer::render(const Particle& obj) const
     }
 }
 
-void Renderer::render(const Bar& obj) const
+void Renderer::render_bar(const Vector2d& start, const Vector2d& end, double strain,
+                          double yield_strain, int id) const
 {
-    int mult = 5;
-    
-    // Color bars according to their strain
-    double strain = obj.get_strain();
-    if (strain > 1.0)
-        strain = 1.0;
-    else if (strain < -1.0)
-        strain = -1.0;
-    
-    if (strain > 0.0)
-        glColor3f(1.0, 1.0 - mult * strain / MAX_STRAIN, 1.0 - mult * strain / MAX_STRAIN);
+    // Color bars according to their strain, fully at the yield strain
+    double colour_strain = strain;
+    if (colour_strain > 1.0)
+        colour_strain = 1.0;
+    else if (colour_strain < -1.0)
+        colour_strain = -1.0;
+    
+    if (colour_strain > 0.0)
+        glColor3f(1.0, 1.0 - colour_strain / yield_strain, 1.0 - colour_strain / yield_strain);
     else
-        glColor3f(1.0 + mult * strain / MAX_STRAIN, 1.0, 1.0);
+        glColor3f(1.0 + colour_strain / yield_strain, 1.0, 1.0);
     
-    Vector2d start = particles[obj.p1_id].position_;
-    Vector2d end = particles[obj.p2_id].position_;
     Vector2d m_mid = 0.5 * (start + end);
     
     // Draw the lines
@@ -126,20 +159,20 @@ void Renderer::render(const Bar& obj) const
     if (settings.get(IDS))
     {
         glColor3f(FUCHSIA);
-        s << obj.id_;
+        s << id;
         glut_print(m_mid.x, m_mid.y, s.str());
     }
     if (settings.get(LENGTHS))
     {
         glColor3f(WHITE);
-        s << std::fixed << obj.length();
+        s << std::fixed << (end - start).abs();
         glut_print(m_mid.x, m_mid.y, s.str());
     }
     if (settings.get(EXTENSIONS))
     {
         glColor3f(WHITE);
         s.str("");
-        s << std::fixed << obj.get_strain();
+        s << std::fixed << strain;
         glut_print(m_mid.x, m_mid.y - px_to_m(12.0), s.str());
     }
 }
@@ -241,7 +274,7 @@ void Renderer::render(const BarsTool &obj) const
             int p_id = obj.selected_particles_ids[i];
             if (particles.exists(p_id))
             {
-                Vector2d selected_pos = particles[p_id].position_;
+                Vector2d selected_pos = particles[p_id].position();
                 glVertex2f(selected_pos.x, selected_pos.y);
                 glVertex2f(obj.tool_pos.x, obj.tool_pos.y);
             }
@@ -260,12 +293,20 @@ void Renderer::render(const BarsTool &obj) const
 
 void Renderer::render(const DragTool &obj) const
 {
+    // While the simulation thread runs, the particles are
+    // taken from the snapshot which is being drawn
+    const WorldSnapshot* snapshot = simulation_thread.running() ? &simulation_thread.snapshot() : NULL;
+    
     // Highlight a particle if it's close to the mouse
     std::vector<int> close_particles;
-    mouse.particles_within(px_to_m(mouse.min_click_dist), close_particles);
+    if (snapshot)
+        snapshot->particles_within(mouse.pos_world, px_to_m(mouse.min_click_dist), close_particles);
+    else
+        mouse.particles_within(px_to_m(mouse.min_click_dist), close_particles);
     for (int i = 0; i < close_particles.size(); i++)
     {
-        Vector2d closest_pos = particles[close_particles[i]].position_;
+        int p_id = close_particles[i];
+        Vector2d closest_pos = snapshot ? snapshot->position[snapshot->index(p_id)] : particles[p_id].position();
         glColor3f(GOLD);
         glPointSize(10);
         glBegin(GL_POINTS);
@@ -277,26 +318,38 @@ void Renderer::render(const DragTool &obj) const
     for (int i = 0; i < obj.dragged_particles.size(); i++)
     {
         int p_id = obj.dragged_particles[i];
-        if (particles.exists(p_id))
+        Vector2d particle_pos_gl;
+        bool fixed;
+        if (snapshot)
+        {
+            int index = snapshot->index(p_id);
+            if (index == -1)
+                continue;
+            particle_pos_gl = snapshot->position[index];
+            fixed = snapshot->fixed[index];
+        }
+        else
         {
-            Particle& active_p = particles[p_id];
-            Vector2d particle_pos_gl = active_p.position_ ;
-            
-            glColor3f(GOLD);
-            glPointSize(10);
-            glBegin(GL_POINTS);
+            if (!particles.exists(p_id))
+                continue;
+            particle_pos_gl = particles[p_id].position();
+            fixed = particles[p_id].fixed();
+        }
+        
+        glColor3f(GOLD);
+        glPointSize(10);
+        glBegin(GL_POINTS);
+        glVertex2f(particle_pos_gl.x, particle_pos_gl.y);
+        glEnd();
+        
+        if (!fixed)
+        {
+            glLineWidth(1.0);
+            glColor4f(GOLD, 0.6);
+            glBegin(GL_LINES);
             glVertex2f(particle_pos_gl.x, particle_pos_gl.y);
+            glVertex2f(mouse.pos_world.x, mouse.pos_world.y);
             glEnd();
-            
-            if (!active_p.fixed_)
-            {
-                glLineWidth(1.0);
-                glColor4f(GOLD, 0.6);
-                glBegin(GL_LINES);
-                glVertex2f(particle_pos_gl.x, particle_pos_gl.y);
-                glVertex2f(mouse.pos_world.x, mouse.pos_world.y);
-                glEnd();
-            }
         }
     }
     
@@ -338,7 +391,7 @@ void Renderer::render(const SelectionTool &obj) const
         for (it = obj.selected.begin(); it != obj.selected.end(); ++it)
         {
             int p_id = *it;
-            Vector2d pos = particles[p_id].position_;
+            Vector2d pos = particles[p_id].position();
             glVertex2d(pos.x, pos.y);
         }
     }
@@ -355,7 +408,7 @@ void Renderer::render(const TraceTool &obj) const
     if (mouse.particle_in_range())
     {
         snapped = true;
-        tool_pos = particles[mouse.closest_particle].position_;
+        tool_pos = particles[mouse.closest_particle].position();
         snapped_particle = mouse.closest_particle;
     }
     
@@ -367,8 +420,8 @@ void Renderer::render(const TraceTool &obj) const
         {
             glColor4f(GREEN, 0.7);
             glLineWidth(2);
-            draw_cross(p.position_, 16);
-            draw_circle(p.position_, px_to_m(8), 20);
+            draw_cross(p.position(), 16);
+            draw_circle(p.position(), px_to_m(8), 20);
         }
     }
     
@@ -386,8 +439,8 @@ void Renderer::render(const SplitTool &obj) const
     if (bars.exists(obj.highlighted_bar))
     {
         Bar& b = bars[obj.highlighted_bar];
-        Vector2d p1 = particles[b.p1_id].position_;
-        Vector2d p2 = particles[b.p2_id].position_;
+        Vector2d p1 = particles[b.p1_id].position();
+        Vector2d p2 = particles[b.p2_id].position();
         
         glColor4f(GOLD, 0.6);
         glLineWidth(3);
@@ -400,8 +453,8 @@ void Renderer::render(const SplitTool &obj) const
     if (bars.exists(obj.selected_bar))
     {
         Bar& b = bars[obj.selected_bar];
-        Vector2d p1 = particles[b.p1_id].position_;
-        Vector2d p2 = particles[b.p2_id].position_;
+        Vector2d p1 = particles[b.p1_id].position();
+        Vector2d p2 = particles[b.p2_id].position();
         
         // Draw the bar highlight
         glColor3f(GOLD);
@@ -454,7 +507,7 @@ void Renderer::render(const MeasureTool &obj) const
     // Snap the position vector
     bool snapped = true;
     if (mouse.particle_in_range())
-        tool_pos = particles[mouse.closest_particle].position_;
+        tool_pos = particles[mouse.closest_particle].position();
     else if (mouse.grid_in_range())
         tool_pos = mouse.closest_grid;
     else
@@ -534,7 +587,7 @@ void Renderer::render(const DeleteTool &obj) const
 {
     if (particles.exists(obj.particle))
     {
-        Vector2d pos = particles[obj.particle].position_;
+        Vector2d pos = particles[obj.particle].position();
         glColor3f(RED);
         glPointSize(10);
         glBegin(GL_POINTS);
@@ -544,8 +597,8 @@ void Renderer::render(const DeleteTool &obj) const
     else if (bars.exists(obj.bar))
     {
         Bar& b = bars[obj.bar];
-        Vector2d p1 = particles[b.p1_id].position_;
-        Vector2d p2 = particles[b.p2_id].position_;
+        Vector2d p1 = particles[b.p1_id].position();
+        Vector2d p2 = particles[b.p2_id].position();
         
         // Draw the bar highlight
         glColor3f(RED);
@@ -9,6 +9,9 @@
 #ifndef __Trusses__renderer__
 #define __Trusses__renderer__
 
+#include <cstddef>
+#include "vector2d.h"
+
 class Particle;
 class Bar;
 class Obstacle;
@@ -23,6 +26,7 @@ class SplitTool;
 class MeasureTool;
 class DeleteTool;
 struct Grid;
+struct WorldSnapshot;
 
 class Renderer
 {
@@ -41,6 +45,16 @@ public:
     void render(const DeleteTool& obj) const;
     void render(const Grid& obj) const;
     void render(const MeasureTool& obj) const;
+    
+    // The structure as published by the simulation thread
+    void render_particles(const WorldSnapshot& obj) const;
+    void render_bars(const WorldSnapshot& obj) const;
+    
+private:
+    void render_trace(const Vector2d* points, size_t size) const;
+    void render_particle(const Vector2d& pos, bool fixed, int id) const;
+    void render_bar(const Vector2d& start, const Vector2d& end, double strain,
+                    double yield_strain, int id) const;
 };
 
 #endif /* defined(__Trusses__renderer__) */
@@ -0,0 +1,303 @@
+//
+//  bench.cpp
+//  Trusses
+//
+//  Times the hot paths on synthetic scenes and prints the results as JSON.
+//  Usage: trusses-bench [-b seconds] [-m max_cloth_size] [-o results.json]
+//  -b is the time spent on each benchmark (at least one run is timed),
+//  -m skips the cloths with more than max_cloth_size particles on a side.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "game.h"
+#include "save.h"
+#include "generator.h"
+#include "particle.h"
+#include "bar.h"
+#include "obstacle.h"
+#include "polygon.h"
+#include "mouse.h"
+#include "window.h"
+#include "various_math.h"
+
+// Temporary file used by the load and save benchmarks
+#define BENCH_FILE "trusses-bench.tr"
+
+double budget_s = 0.5;
+
+double seconds_since(unsigned long long start)
+{
+    unsigned long long now;
+    microsecond_time(now);
+    return (now - start) / 1000000.0;
+}
+
+// * * * * * * * * * * //
+// Results are collected as JSON objects
+class Results
+{
+public:
+    void begin(const std::string& benchmark, const std::string& scene)
+    {
+        if (!entries.empty())
+            entries += ",\n";
+        entries += "    {\"benchmark\": \"" + benchmark + "\", \"scene\": \"" + scene + "\"";
+    }
+    
+    void add(const std::string& key, double value)
+    {
+        std::ostringstream s;
+        s.precision(10);
+        s << ", \"" << key << "\": " << value;
+        entries += s.str();
+    }
+    
+    void end()
+    {
+        entries += "}";
+    }
+    
+    void write(std::ostream& s) const
+    {
+        s << "{\n  \"results\": [\n" << entries << "\n  ]\n}" << std::endl;
+    }
+    
+private:
+    std::string entries;
+};
+
+Results results;
+
+// * * * * * * * * * * //
+// A row of blocks with bumpy tops and cloths falling onto them
+void create_terrain(int blocks)
+{
+    const double width = 1.5;
+    double x0 = -blocks * width / 2.0;
+    srand(1);
+    for (int i = 0; i < blocks; i++)
+    {
+        double left = x0 + i * width;
+        Polygon poly;
+        poly.add_point(Vector2d(left, -10.0));
+        poly.add_point(Vector2d(left + width, -10.0));
+        for (int k = 6; k >= 0; k--)
+            poly.add_point(Vector2d(left + k * width / 6, -2.0 + random(1.0)));
+        Obstacle::create(poly);
+    }
+    
+    // Every ten blocks get a cloth of their own
+    for (int i = 0; i < blocks; i += 10)
+        create_cloth(10, width, Vector2d(x0 + i * width, 0.0), false);
+}
+
+// * * * * * * * * * * //
+// Builds the scene and times the simulation steps
+void bench_steps(const std::string& scene, void (*build)(int), int size)
+{
+    game.reset();
+    unsigned long long start;
+    microsecond_time(start);
+    build(size);
+    double build_s = seconds_since(start);
+    
+    game.enter_simulation();
+    int steps = 0;
+    microsecond_time(start);
+    do
+    {
+        game.update_simulation();
+        steps++;
+    } while (seconds_since(start) < budget_s);
+    double elapsed_s = seconds_since(start);
+    
+    results.begin("steps", scene);
+    results.add("particles", particles.size());
+    results.add("bars", bars.size());
+    results.add("obstacles", obstacles.size());
+    results.add("build_s", build_s);
+    results.add("steps", steps);
+    results.add("steps_per_s", steps / elapsed_s);
+    results.end();
+}
+
+void build_cloth(int n) {create_cloth(n, 0.5, Vector2d(-n * 0.25, 0.0), true);}
+void build_tower(int levels) {create_tower(levels, 1.0, Vector2d(0.0, 0.0));}
+void build_bridge(int panels) {create_warren_bridge(panels, 2.0, Vector2d(0.0, 0.0));}
+void build_pratt(int panels) {create_pratt_bridge(panels, 2.0, Vector2d(0.0, 0.0));}
+void build_truss(int n) {create_random_truss(n, std::sqrt((double)n), Vector2d(0.0, 0.0), 1);}
+void build_terrain(int blocks) {create_terrain(blocks);}
+
+// Saves the scene to a file and loads it back
+void bench_io(const std::string& scene, int n)
+{
+    game.reset();
+    build_cloth(n);
+    int elements = particles.size() + bars.size();
+    
+    unsigned long long start;
+    microsecond_time(start);
+    save(BENCH_FILE);
+    double save_s = seconds_since(start);
+    
+    std::ifstream file(BENCH_FILE, std::ios::binary | std::ios::ate);
+    double bytes = file.tellg();
+    file.close();
+    
+    microsecond_time(start);
+    int failed = load(BENCH_FILE);
+    double load_s = seconds_since(start);
+    std::remove(BENCH_FILE);
+    if (failed)
+    {
+        std::cerr << "Could not load " << BENCH_FILE << std::endl;
+        return;
+    }
+    
+    results.begin("io", scene);
+    results.add("elements", elements);
+    results.add("bytes", bytes);
+    results.add("save_s", save_s);
+    results.add("load_s", load_s);
+    results.add("save_mb_per_s", bytes / save_s / 1e6);
+    results.add("load_mb_per_s", bytes / load_s / 1e6);
+    results.end();
+}
+
+// Ear clipping of a star-shaped polygon with n vertices
+void bench_triangulate(int n)
+{
+    srand(1);
+    Polygon poly;
+    for (int i = 0; i < n; i++)
+    {
+        double angle = -2 * M_PI * i / n;
+        double r = 10.0 + random(2.0);
+        poly.add_point(Vector2d(r * cos(angle), r * sin(angle)));
+    }
+    
+    int runs = 0;
+    unsigned long long start;
+    microsecond_time(start);
+    do
+    {
+        poly.triangulate();
+        runs++;
+    } while (seconds_since(start) < budget_s);
+    double elapsed_s = seconds_since(start);
+    
+    std::ostringstream scene;
+    scene << "polygon_" << n;
+    results.begin("triangulate", scene.str());
+    results.add("vertices", n);
+    results.add("runs", runs);
+    results.add("us_per_run", 1e6 * elapsed_s / runs);
+    results.end();
+}
+
+// Moves the mouse over the cloth, finding the closest particle and bar
+void bench_picking(const std::string& scene, int n)
+{
+    game.reset();
+    build_cloth(n);
+    window.centre = Vector2d(0.0, n * 0.25);
+    
+    srand(1);
+    int moves = 0;
+    int found = 0;
+    unsigned long long start;
+    microsecond_time(start);
+    do
+    {
+        mouse.update(rand() % (int)window.width, rand() % (int)window.height);
+        if (mouse.find_closest_bar(mouse.min_click_dist) != -1)
+            found++;
+        moves++;
+    } while (seconds_since(start) < budget_s);
+    double elapsed_s = seconds_since(start);
+    
+    results.begin("picking", scene);
+    results.add("particles", particles.size());
+    results.add("bars", bars.size());
+    results.add("moves", moves);
+    results.add("bars_found", found);
+    results.add("us_per_move", 1e6 * elapsed_s / moves);
+    results.end();
+}
+
+// * * * * * * * * * * //
+int main(int argc, char * argv[])
+{
+    int max_cloth = 1000;
+    std::string output;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-b" && i + 1 < argc && std::atof(argv[i+1]) > 0.0)
+            budget_s = std::atof(argv[++i]);
+        else if (arg == "-m" && i + 1 < argc && std::atoi(argv[i+1]) > 0)
+            max_cloth = std::atoi(argv[++i]);
+        else if (arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else
+        {
+            std::cout << "Usage: trusses-bench [-b seconds] [-m max_cloth_size] [-o results.json]" << std::endl;
+            return 1;
+        }
+    }
+    
+    int cloth_sizes[] = {10, 32, 100, 316, 1000};
+    for (int i = 0; i < 5; i++)
+    {
+        if (cloth_sizes[i] > max_cloth)
+            continue;
+        std::ostringstream scene;
+        scene << "cloth_" << cloth_sizes[i];
+        bench_steps(scene.str(), build_cloth, cloth_sizes[i]);
+    }
+    bench_steps("tower_100", build_tower, 100);
+    bench_steps("tower_1000", build_tower, 1000);
+    bench_steps("bridge_100", build_bridge, 100);
+    bench_steps("bridge_1000", build_bridge, 1000);
+    bench_steps("pratt_1000", build_pratt, 1000);
+    bench_steps("delaunay_10000", build_truss, 10000);
+    bench_steps("terrain_100", build_terrain, 100);
+    bench_steps("terrain_1000", build_terrain, 1000);
+    
+    for (int i = 0; i < 5; i++)
+    {
+        if (cloth_sizes[i] < 100 || cloth_sizes[i] > max_cloth)
+            continue;
+        std::ostringstream scene;
+        scene << "cloth_" << cloth_sizes[i];
+        bench_io(scene.str(), cloth_sizes[i]);
+        bench_picking(scene.str(), cloth_sizes[i]);
+    }
+    
+    bench_triangulate(100);
+    bench_triangulate(300);
+    bench_triangulate(1000);
+    
+    if (output.empty())
+        results.write(std::cout);
+    else
+    {
+        std::ofstream file(output.c_str());
+        if (!file.is_open())
+        {
+            std::cerr << "Could not open " << output << std::endl;
+            return 1;
+        }
+        results.write(file);
+    }
+    
+    return 0;
+}
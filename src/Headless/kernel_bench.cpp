@@ -0,0 +1,86 @@
+//
+//  kernel_bench.cpp
+//  Trusses
+//
+//  Compares the relaxation kernels on cloths made by create_cloth().
+//  Usage: trusses-kernel-bench [passes]
+//
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+
+#include "game.h"
+#include "generator.h"
+#include "particle.h"
+#include "constraint_table.h"
+#include "relax_kernels.h"
+#include "various_math.h"
+
+// Runs the kernel on every colour batch of the table,
+// returns the time in seconds
+double time_kernel(RelaxKernel kernel, int passes)
+{
+    unsigned long long start, end;
+    microsecond_time(start);
+    for (int j = 0; j < passes; j++)
+        for (unsigned int c = 0; c < constraints.colours(); c++)
+            kernel(constraints, particle_store, constraints.colour_start[c], constraints.colour_start[c+1]);
+    microsecond_time(end);
+    return (end - start) / 1000000.0;
+}
+
+int main(int argc, char * argv[])
+{
+    int passes = 100;
+    if (argc == 2)
+        passes = std::atoi(argv[1]);
+    if (passes < 1)
+    {
+        std::cout << "Usage: trusses-kernel-bench [passes]" << std::endl;
+        return 1;
+    }
+    
+    if (!avx2_supported())
+        std::cout << "AVX2 is not supported, the vectorised kernel falls back to scalar" << std::endl;
+    
+    std::cout << std::setw(10) << "particles" << std::setw(10) << "bars"
+              << std::setw(14) << "scalar ns/bar" << std::setw(14) << "avx2 ns/bar"
+              << std::setw(10) << "speedup" << std::setw(14) << "max diff" << std::endl;
+    
+    int sizes[] = {32, 100, 316, 1000};
+    for (int s = 0; s < 4; s++)
+    {
+        int n = sizes[s];
+        game.reset();
+        create_cloth(n, 0.5, Vector2d(0.0, 0.0), true);
+        
+        // Disturb the cloth so that every bar has some work to do
+        srand(1);
+        for (int i = 0; i < particle_store.size(); i++)
+            particle_store.position[i] += Vector2d(random(0.05), random(0.05));
+        constraints.rebuild();
+        
+        // Both kernels start from the same positions
+        std::vector<Vector2d> initial = particle_store.position;
+        double scalar_s = time_kernel(relax_scalar, passes);
+        std::vector<Vector2d> scalar_result = particle_store.position;
+        
+        particle_store.position = initial;
+        double avx2_s = time_kernel(relax_avx2, passes);
+        
+        double max_diff = 0.0;
+        for (int i = 0; i < particle_store.size(); i++)
+            max_diff = max(max_diff, (particle_store.position[i] - scalar_result[i]).abs());
+        
+        double bar_passes = 1.0 * constraints.size() * passes;
+        std::cout << std::setw(10) << particle_store.size() << std::setw(10) << constraints.size()
+                  << std::setw(14) << std::setprecision(3) << 1e9 * scalar_s / bar_passes
+                  << std::setw(14) << 1e9 * avx2_s / bar_passes
+                  << std::setw(10) << scalar_s / avx2_s
+                  << std::setw(14) << max_diff << std::endl;
+    }
+    
+    return 0;
+}
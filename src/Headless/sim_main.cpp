@@ -0,0 +1,276 @@
+//
+//  sim_main.cpp
+//  Trusses
+//
+//  Runs the simulation without graphics. Usage:
+//  trusses-sim [-n steps] [-t timestep_ms] [-p] [-I] [-j threads] [-x] [-i passes] [-d cell_size] [-c radius] [-s] [-P profile.csv] [-T trace.json] [-r journal.trj] [-o output.tr] [-q] <file.tr | -g type size | -R journal.trj>
+//  -p uses the parallel (coloured) solver, -I steps the separate structures
+//  (islands) in parallel instead. -j sets the number of threads of either.
+//  -x uses the XPBD solver, -i sets the maximum number of relaxation passes.
+//  -d gives the obstacles without a saved distance field one with the given cell size.
+//  -c turns on the collisions between joints and bars with the given joint radius.
+//  -s solves for the static equilibrium and prints the bar forces instead.
+//  -P writes the time spent in each phase of every step to a CSV file.
+//  -T writes a timeline of the last steps in the Chrome trace event format.
+//  -g simulates a generated structure instead of a file (see generate()).
+//  -r records the run in a journal, -R replays a journal instead of running
+//  a file and checks that it ends in the recorded state. The replay takes
+//  its settings and number of steps from the journal. It exits with 1 if
+//  the state differs or the replay stopped before the end of the journal.
+//
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include "game.h"
+#include "save.h"
+#include "generator.h"
+#include "journal.h"
+#include "interpreter.h"
+#include "particle.h"
+#include "bar.h"
+#include "solver.h"
+#include "thread_pool.h"
+#include "static_solver.h"
+#include "islands.h"
+#include "obstacle.h"
+#include "self_collision.h"
+#include "profiler.h"
+#include "timeline.h"
+
+void print_usage()
+{
+    std::cout << "Usage: trusses-sim [-n steps] [-t timestep_ms] [-p] [-I] [-j threads] [-x] [-i passes] [-d cell_size] [-c radius] [-s] [-P profile.csv] [-T trace.json] [-r journal.trj] [-o output.tr] [-q] <file.tr | -g type size | -R journal.trj>" << std::endl;
+}
+
+// Executes a command replayed from the journal
+void run_command(const std::string& command)
+{
+    Interpreter interpreter;
+    interpreter.command = command;
+    interpreter.interpret();
+}
+
+// Prints the forces in the equilibrium of the loaded structure
+int run_static(bool quiet)
+{
+    unsigned long long start, end;
+    microsecond_time(start);
+    int result = static_solver.solve();
+    microsecond_time(end);
+    
+    std::cout << "particles: " << particles.size() << std::endl;
+    std::cout << "bars: " << bars.size() << std::endl;
+    std::cout << "unknowns: " << static_solver.unknowns() << std::endl;
+    std::cout << "iterations: " << static_solver.iterations() << std::endl;
+    std::cout << "residual: " << static_solver.residual() << std::endl;
+    std::cout << "wall time: " << (end - start) / 1000000.0 << " s" << std::endl;
+    if (result)
+        std::cerr << "The solution didn't converge, the structure may be a mechanism" << std::endl;
+    
+    if (!quiet)
+    {
+        std::cout << std::endl;
+        for (int i = 0; i < bars.size(); i++)
+        {
+            const Bar& b = bars.at(i);
+            std::cout << "b" << b.id_ << " " << b.get_static_force() << " "
+                      << b.get_static_strain() << std::endl;
+        }
+    }
+    return result;
+}
+
+int main(int argc, char * argv[])
+{
+    int n_steps = 1000;
+    double step_ms = game.dt_us() / 1000.0;
+    std::string input;
+    std::string output;
+    std::string profile_csv;
+    std::string trace_json;
+    std::string generated;
+    std::string record;
+    std::string replay;
+    int generated_size = 0;
+    bool quiet = false;
+    bool static_analysis = false;
+    
+    // Read the options
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+            n_steps = std::atoi(argv[++i]);
+        else if (arg == "-t" && i + 1 < argc)
+            step_ms = std::atof(argv[++i]);
+        else if (arg == "-p")
+            solver.mode = COLOURED_SOLVER;
+        else if (arg == "-I")
+            solver.mode = ISLAND_SOLVER;
+        else if (arg == "-j" && i + 1 < argc && std::atoi(argv[i+1]) > 0)
+            thread_pool.set_threads(std::atoi(argv[++i]));
+        else if (arg == "-x")
+            solver.method = XPBD_RELAX;
+        else if (arg == "-i" && i + 1 < argc && std::atoi(argv[i+1]) > 0)
+        {
+            solver.max_iterations = std::atoi(argv[++i]);
+            if (solver.min_iterations > solver.max_iterations)
+                solver.min_iterations = solver.max_iterations;
+        }
+        else if (arg == "-d" && i + 1 < argc && std::atof(argv[i+1]) > 0.0)
+            Obstacle::field_cell_size = std::atof(argv[++i]);
+        else if (arg == "-c" && i + 1 < argc && std::atof(argv[i+1]) > 0.0)
+        {
+            self_collision.enabled = true;
+            self_collision.radius = std::atof(argv[++i]);
+        }
+        else if (arg == "-s")
+            static_analysis = true;
+        else if (arg == "-P" && i + 1 < argc)
+            profile_csv = argv[++i];
+        else if (arg == "-T" && i + 1 < argc)
+            trace_json = argv[++i];
+        else if (arg == "-g" && i + 2 < argc)
+        {
+            generated = argv[++i];
+            generated_size = std::atoi(argv[++i]);
+        }
+        else if (arg == "-r" && i + 1 < argc)
+            record = argv[++i];
+        else if (arg == "-R" && i + 1 < argc)
+            replay = argv[++i];
+        else if (arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "-q")
+            quiet = true;
+        else if (input.empty() && arg[0] != '-')
+            input = arg;
+        else
+        {
+            print_usage();
+            return 1;
+        }
+    }
+    
+    int sources = !input.empty() + !generated.empty() + !replay.empty();
+    if (sources != 1 || n_steps < 0 || step_ms <= 0.0)
+    {
+        print_usage();
+        return 1;
+    }
+    
+    if (!generated.empty())
+    {
+        unsigned long long start, end;
+        microsecond_time(start);
+        if (generate(generated, generated_size))
+        {
+            std::cerr << "Could not generate " << generated << " " << generated_size << std::endl;
+            return 1;
+        }
+        microsecond_time(end);
+        std::cout << "generated in: " << (end - start) / 1000000.0 << " s" << std::endl;
+    }
+    else if (!input.empty() && load(input))
+    {
+        std::cerr << "Could not load the file " << input << std::endl;
+        return 1;
+    }
+    if (static_analysis && replay.empty())
+        return run_static(quiet);
+    
+    journal.run_command = run_command;
+    if (!replay.empty())
+    {
+        if (journal.start_replay(replay))
+        {
+            std::cerr << "Could not replay the journal " << replay << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        game.set_step(step_ms * 1000.0);
+        game.enter_simulation();
+    }
+    if (!record.empty() && journal.start_recording(record))
+    {
+        std::cerr << "Could not open the file " << record << std::endl;
+        return 1;
+    }
+    
+    // Each step is one frame of the profile
+    if (!profile_csv.empty())
+    {
+        if (profiler.open_csv(profile_csv))
+        {
+            std::cerr << "Could not open the file " << profile_csv << std::endl;
+            return 1;
+        }
+        profiler.enabled = true;
+    }
+    timeline.enabled = !trace_json.empty();
+    
+    // Run the simulation
+    unsigned long long start, end;
+    long long total_iterations = 0;
+    microsecond_time(start);
+    if (!replay.empty())
+        n_steps = 0;
+    for (int i = 0; replay.empty() ? i < n_steps : journal.replaying() && game.simulation_running(); i++)
+    {
+        game.update_simulation();
+        total_iterations += solver.last_iterations();
+        profiler.end_frame();
+        if (!replay.empty())
+            n_steps++;
+    }
+    microsecond_time(end);
+    journal.stop_recording();
+    
+    double elapsed_s = (end - start) / 1000000.0;
+    std::cout << "particles: " << particles.size() << std::endl;
+    std::cout << "bars: " << bars.size() << std::endl;
+    std::cout << "steps: " << n_steps << std::endl;
+    std::cout << "sleeping particles: " << islands.sleeping_particles() << std::endl;
+    std::cout << "simulated time: " << game.simulation_time_s() << " s" << std::endl;
+    std::cout << "wall time: " << elapsed_s << " s" << std::endl;
+    if (n_steps > 0)
+        std::cout << "relaxation passes/step: " << double(total_iterations) / n_steps << std::endl;
+    if (elapsed_s > 0.0)
+        std::cout << "steps/sec: " << n_steps / elapsed_s << std::endl;
+    if (profiler.enabled)
+    {
+        for (int i = 0; i < PROFILE_PHASES; i++)
+            if (profiler.average_ms((ProfilePhase)i) > 0.0)
+                std::cout << Profiler::phase_name((ProfilePhase)i) << ": "
+                          << profiler.average_ms((ProfilePhase)i) << " ms/step" << std::endl;
+        profiler.close_csv();
+    }
+    if (!trace_json.empty() && timeline.dump(trace_json))
+        std::cerr << "Could not write the file " << trace_json << std::endl;
+    int result = 0;
+    if (!replay.empty())
+    {
+        if (!journal.replay_finished())
+            std::cout << "replay: stopped before the end of the journal" << std::endl;
+        else
+            std::cout << "replay: " << (journal.replay_matches() ? "matches" : "differs from")
+                      << " the recording" << std::endl;
+        if (!journal.replay_finished() || !journal.replay_matches())
+            result = 1;
+    }
+    
+    // Print the final state
+    if (!quiet)
+    {
+        std::cout << std::endl;
+        save(std::cout);
+    }
+    if (!output.empty())
+        save(output);
+    
+    return result;
+}
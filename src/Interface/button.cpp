@@ -181,6 +181,17 @@ void action_edit()
     game.enter_editor();
 }
 
+// Fast-forward
+void action_fast_forward()
+{
+    game.set_fast_forward(!game.fast_forward());
+}
+
+bool active_fast_forward()
+{
+    return game.fast_forward();
+}
+
 // Selection tool
 void action_selection_tool()
 {
@@ -310,6 +321,7 @@ void create_buttons_simulation()
     Button::create(w, h, -1.0, 1.0, lmargin, -tmargin-9*dy, &action_scale_down, NULL, "     -");
     
     Button::create(w, h, -1.0, 1.0, lmargin, -tmargin-10.5*dy, &action_edit, NULL, "Edit");
+    Button::create(w, h, -1.0, 1.0, lmargin, -tmargin-11.5*dy, &action_fast_forward, &active_fast_forward, "Fast");
     
     refresh_buttons();
 }
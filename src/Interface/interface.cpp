@@ -17,11 +17,19 @@
 
 #include "button.h"
 #include "save.h"
+#include "generator.h"
 #include "interpreter.h"
 #include "mouse.h"
 #include "game.h"
 #include "settings.h"
 #include "tool.h"
+#include "bars_tool.h"
+#include "drag_tool.h"
+#include "temporary_label.h"
+#include "window.h"
+#include "timeline.h"
+#include "journal.h"
+#include "simulation_thread.h"
 #include <cstdlib>
 
 Arrows::Arrows()
@@ -38,13 +46,6 @@ bool command_mode = false;
 Tool* current_tool = 0;
 Interpreter interpreter;
 
-// * * * * * * * * * * //
-Vector2d px_to_m(const Vector2d& v) {return Vector2d(px_to_m(v.x), px_to_m(v.y));}
-double px_to_m(double d) {return d / window.get_scale();}
-Vector2d px_to_ui(const Vector2d& v) {return Vector2d(px_to_ui_x(v.x), px_to_ui_y(v.y));}
-double px_to_ui_x(double d) {return d / (window.width/2.0);}
-double px_to_ui_y(double d) {return d / (window.height/2.0);}
-
 // * * * * * * * * * * //
 void command_key_down(unsigned char key, int x, int y)
 {
@@ -61,6 +62,7 @@ void command_key_down(unsigned char key, int x, int y)
         }
         case 13:
         {
+            SimulationPause pause;
             interpreter.interpret();
             interpreter.command = "";
             command_mode = false;
@@ -92,12 +94,16 @@ void command_key_down(unsigned char key, int x, int y)
 void key_down(unsigned char key, int x, int y)
 {
     mouse.update(x, y);
+    
+    // Keys can change the structure and the simulation settings
+    SimulationPause pause;
 
     switch (key)
     {
         case 'g':
         {
-            settings.toggle(GRAVITY);
+            game.set_gravity(!settings.get(GRAVITY));
+            journal.record_command(settings.get(GRAVITY) ? "gravity on" : "gravity off");
             break;
         }
         case 'o':
@@ -107,6 +113,9 @@ void key_down(unsigned char key, int x, int y)
         }
         case 27:
         {
+            // The journal needs its end to be checked
+            simulation_thread.stop();
+            journal.stop_recording();
             Tool::set(current_tool, NULL);
             game.reset();
             std::exit(0);
@@ -208,6 +217,7 @@ void mouse_click(int button, int state, int x, int y)
         {
             if (buttons[i].is_highlighted())
             {
+                SimulationPause pause;
                 buttons[i].execute_action();
                 return;
             }
@@ -243,11 +253,69 @@ void register_callbacks()
     glutMotionFunc(mouse_drag);
     glutSpecialFunc(special_key_down);
     glutSpecialUpFunc(special_key_up);
+    
+    game.editor_entered = interface_enter_editor;
+    game.simulation_entered = interface_enter_simulation;
+    game.game_reset = interface_reset;
+    journal.run_command = interface_run_command;
+}
+
+void interface_enter_editor()
+{
+    // The editor tools change the structure directly
+    simulation_thread.stop();
+    
+    Tool::set(current_tool, new BarsTool);
+    
+    temp_labels.clear();
+    TempLabel::create("Editor mode - you can draw the structure.", 0, 1.0, 0, -TOP_MARGIN, MODE_LABEL_TIME);
+    buttons.clear();
+    create_buttons_editor();
+    
+    mouse.min_click_dist = 10;
+}
+
+void interface_enter_simulation()
+{
+    Tool::set(current_tool, new DragTool);
+    
+    temp_labels.clear();
+    TempLabel::create("Simulation mode - you can drag the joints.", 0, 1.0, 0, -TOP_MARGIN, MODE_LABEL_TIME);
+    buttons.clear();
+    create_buttons_simulation();
+    
+    mouse.min_click_dist = 20;
+}
+
+void interface_reset()
+{
+    window.reset();
+}
+
+void interface_run_command(const std::string& command)
+{
+    // The command being typed is left alone
+    Interpreter replayed;
+    replayed.command = command;
+    replayed.interpret();
 }
 
 void idle()
 {
-    game.update();
-    window.update(arrows, game.dt_s());
+    TraceSpan span("idle");
+    
+    // The simulation runs on its own thread in the simulation mode, except
+    // during replays, whose commands have to run on this thread
+    if (simulation_thread.running() && (simulation_thread.finished() || !settings.get(THREADED)))
+        simulation_thread.stop();
+    else if (!simulation_thread.running() && settings.get(THREADED) &&
+             game.simulation_running() && !journal.replaying())
+        simulation_thread.start();
+    
+    if (simulation_thread.running())
+        game.update_frame();
+    else
+        game.update();
+    window.update(arrows, game.frame_dt_s());
     glutPostRedisplay();
 }
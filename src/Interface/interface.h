@@ -25,6 +25,14 @@ void mouse_drag(int x, int y);
 void register_callbacks();
 void idle();
 
+// Update the interface when the game changes its state
+void interface_enter_editor();
+void interface_enter_simulation();
+void interface_reset();
+
+// Executes a command replayed from the journal
+void interface_run_command(const std::string& command);
+
 // Some helper functions to convert between the coordinates
 Vector2d px_to_m(const Vector2d& v);
 double px_to_m(double d);
@@ -15,6 +15,8 @@
 #include <limits>
 #include "settings.h"
 #include "segment.h"
+#include "profiler.h"
+#include "simulation_thread.h"
 
 Mouse mouse;
 
@@ -37,16 +39,23 @@ void Mouse::update(int x, int y)
     pos_world = Vector2d(px_to_m(pos_screen.x) + window.centre.x, px_to_m(pos_screen.y) + window.centre.y);
     pos_ui = Vector2d(x * 2.0 / window.width - 1.0, 1.0 - y * 2.0 / window.height);
     
-    // Update the closest particle
-    double least_dist2 = std::numeric_limits<float>::max();
-    for (int i = 0; i < particles.size(); i++)
+    // Update the closest particle. It's only needed by the editor tools,
+    // and the particles belong to the simulation thread while it runs.
+    ScopedTimer timer(PHASE_PICKING);
+    if (simulation_thread.running())
+        closest_particle = -1;
+    else
     {
-        Particle& p = particles.at(i);
-        double dist2_m = (pos_world - p.position_).abs2();
-        if (dist2_m < least_dist2)
+        double least_dist2 = std::numeric_limits<float>::max();
+        for (int i = 0; i < particles.size(); i++)
         {
-            closest_particle = p.id_;
-            least_dist2 = dist2_m;
+            Particle& p = particles.at(i);
+            double dist2_m = (pos_world - p.position()).abs2();
+            if (dist2_m < least_dist2)
+            {
+                closest_particle = p.id_;
+                least_dist2 = dist2_m;
+            }
         }
     }
     
@@ -67,7 +76,7 @@ bool Mouse::in_range(Vector2d point) const
 Vector2d Mouse::snap()
 {
     if (particle_in_range())
-        return particles[closest_particle].position_;
+        return particles[closest_particle].position();
     else if (grid_in_range())
         return closest_grid;
     return mouse.pos_world;
@@ -88,18 +97,19 @@ bool Mouse::particle_in_range() const
 {
     if (!particles.exists(closest_particle))
         return false;
-    if (in_range(particles[closest_particle].position_))
+    if (in_range(particles[closest_particle].position()))
         return true;
     return false;
 }
 
 void Mouse::particles_within(double dist, std::vector<int>& part) const
 {
+    ScopedTimer timer(PHASE_PICKING);
     double dist2 = dist * dist;
     for (int i = 0; i < particles.size(); i++)
     {
         Particle& p = particles.at(i);
-        double dist2_m = (pos_world - p.position_).abs2();
+        double dist2_m = (pos_world - p.position()).abs2();
         if (dist2_m < dist2)
             part.push_back(p.id_);
     }
@@ -107,6 +117,7 @@ void Mouse::particles_within(double dist, std::vector<int>& part) const
 
 int Mouse::find_closest_bar(int px_range) const
 {
+    ScopedTimer timer(PHASE_PICKING);
     int bar = -1;
     double m_range = px_to_m(px_range);
     double smallest_dist2 = std::numeric_limits<double>::max();
@@ -115,8 +126,8 @@ int Mouse::find_closest_bar(int px_range) const
         Bar& b = bars.at(i);
         
         // Check if the point is "within" the bar
-        Vector2d p1 = particles[b.p2_id].position_;
-        Vector2d p2 = particles[b.p1_id].position_;
+        Vector2d p1 = particles[b.p2_id].position();
+        Vector2d p2 = particles[b.p1_id].position();
         
         if ((p2-p1)*(mouse.pos_world-p1) > 0 && (p1-p2)*(mouse.pos_world-p2) > 0)
         {
@@ -28,6 +28,7 @@ void Settings::reset()
     draw_bounding_boxes = false;
     draw_triangulation = false;
     gravity = true;
+    threaded = true;
     
     save_path = "";
 }
@@ -52,6 +53,8 @@ bool& Settings::bool_member(bool_settings bool_var)
             return draw_triangulation;
         case GRAVITY:
             return gravity;
+        case THREADED:
+            return threaded;
         default:
             throw std::invalid_argument("Unknown setting");
     }
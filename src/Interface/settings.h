@@ -11,7 +11,7 @@
 
 #include <iostream>
 
-enum bool_settings {LENGTHS, EXTENSIONS, GRID, IDS, PARTICLES, BOUNDING_BOXES, TRIANGULATION, GRAVITY};
+enum bool_settings {LENGTHS, EXTENSIONS, GRID, IDS, PARTICLES, BOUNDING_BOXES, TRIANGULATION, GRAVITY, THREADED};
 enum string_settings {SAVE_PATH};
 
 class Settings
@@ -45,6 +45,9 @@ private:
     bool draw_triangulation;
     bool gravity;
     
+    // The simulation runs on its own thread (see SimulationThread)
+    bool threaded;
+    
     // Strings
     std::string save_path;
 };
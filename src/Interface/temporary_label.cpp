@@ -7,7 +7,6 @@
 //
 
 #include "temporary_label.h"
-#include "renderer.h"
 #include "game.h"
 
 SlotMap<TempLabel> temp_labels;
@@ -33,7 +32,7 @@ int TempLabel::create(std::string str, double pos_x, double pos_y, int off_x, in
 // The return value of 1 means "remove me"
 int TempLabel::update()
 {
-    time += game.dt_us();
+    time += game.frame_dt_us();
     if (time > max_time)
         return 1;
     return 0;
@@ -47,11 +46,6 @@ float TempLabel::alpha() const
     return 1.0;
 }
 
-void TempLabel::draw(const Renderer& rend) const
-{
-    rend.render(*this);
-}
-
 int TempLabel::destroy(int obj_id)
 {
     int result = temp_labels.remove(obj_id);
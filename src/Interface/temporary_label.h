@@ -43,8 +43,6 @@ public:
     // Updates the label, returns 1 if it should be destroyed,
     // 0 otherwise. This method shoudld be called every frame.
     int update();
-    
-    void draw(const Renderer& rend) const;
 
     // Removes the label with given id
     static int destroy(int obj_id);
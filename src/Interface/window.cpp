@@ -12,6 +12,14 @@
 
 Window window(1000, 700, 50);
 
+// Conversions declared in interface.h. They only depend on the window,
+// so that the mouse can be used without graphics (see trusses-bench).
+Vector2d px_to_m(const Vector2d& v) {return Vector2d(px_to_m(v.x), px_to_m(v.y));}
+double px_to_m(double d) {return d / window.get_scale();}
+Vector2d px_to_ui(const Vector2d& v) {return Vector2d(px_to_ui_x(v.x), px_to_ui_y(v.y));}
+double px_to_ui_x(double d) {return d / (window.width/2.0);}
+double px_to_ui_y(double d) {return d / (window.height/2.0);}
+
 Window::Window(double w, double h, double s): width(w), height(h), scale(s)
 {
     centre = Vector2d(0.0, 0.0);
@@ -0,0 +1,130 @@
+//
+//  distance_field.cpp
+//  Trusses
+//
+
+#include "distance_field.h"
+#include <cmath>
+#include "edge_tree.h"
+
+DistanceField::DistanceField()
+{
+    cell = 1.0;
+    nx = ny = 0;
+}
+
+void DistanceField::clear()
+{
+    values.clear();
+    nx = ny = 0;
+}
+
+void DistanceField::build(const EdgeTree& edges, const Vector2d& box_min,
+                          const Vector2d& box_max, double cell_size)
+{
+    clear();
+    if (edges.empty() || cell_size <= 0.0)
+        return;
+    
+    Vector2d size = box_max - box_min;
+    cell = sampled_cell_size(size, cell_size);
+    origin = box_min - Vector2d(2 * cell, 2 * cell);
+    nx = (int)std::ceil(size.x / cell) + 5;
+    ny = (int)std::ceil(size.y / cell) + 5;
+    values.resize(nx * ny);
+    
+    for (int j = 0; j < ny; j++)
+    {
+        for (int i = 0; i < nx; i++)
+        {
+            Vector2d p = origin + Vector2d(i * cell, j * cell);
+            double d = edges.distance(p);
+            values[j * nx + i] = (float)(edges.point_inside(p) ? -d : d);
+        }
+    }
+}
+
+double DistanceField::sampled_cell_size(const Vector2d& box_size, double cell_size)
+{
+    // Keep the number of samples reasonable
+    double cell = cell_size;
+    while ((box_size.x / cell + 5) * (box_size.y / cell + 5) > MAX_FIELD_SAMPLES)
+        cell *= 2.0;
+    return cell;
+}
+
+bool DistanceField::covers(const Vector2d& p) const
+{
+    if (values.empty())
+        return false;
+    double x = (p.x - origin.x) / cell;
+    double y = (p.y - origin.y) / cell;
+    return x >= 0.0 && y >= 0.0 && x <= nx - 1 && y <= ny - 1;
+}
+
+void DistanceField::locate(const Vector2d& p, int& i, int& j, double& fx, double& fy) const
+{
+    double x = (p.x - origin.x) / cell;
+    double y = (p.y - origin.y) / cell;
+    i = (int)std::floor(x);
+    j = (int)std::floor(y);
+    
+    // Points on the last row or column use the cell before it
+    if (i > nx - 2)
+        i = nx - 2;
+    if (j > ny - 2)
+        j = ny - 2;
+    fx = x - i;
+    fy = y - j;
+}
+
+double DistanceField::distance(const Vector2d& p) const
+{
+    int i, j;
+    double fx, fy;
+    locate(p, i, j, fx, fy);
+    double bottom = at(i, j) + fx * (at(i+1, j) - at(i, j));
+    double top = at(i, j+1) + fx * (at(i+1, j+1) - at(i, j+1));
+    return bottom + fy * (top - bottom);
+}
+
+Vector2d DistanceField::gradient(const Vector2d& p) const
+{
+    int i, j;
+    double fx, fy;
+    locate(p, i, j, fx, fy);
+    double gx = (1 - fy) * (at(i+1, j) - at(i, j)) + fy * (at(i+1, j+1) - at(i, j+1));
+    double gy = (1 - fx) * (at(i, j+1) - at(i, j)) + fx * (at(i+1, j+1) - at(i+1, j));
+    return Vector2d(gx, gy) / cell;
+}
+
+void DistanceField::write(std::ostream& out) const
+{
+    // Doubles need 17 digits to be read back exactly, floats 9
+    std::streamsize precision = out.precision(17);
+    out << origin << ' ' << cell << ' ' << nx << ' ' << ny;
+    out.precision(9);
+    for (size_t k = 0; k < values.size(); k++)
+        out << ' ' << values[k];
+    out.precision(precision);
+}
+
+int DistanceField::read(const std::vector<double>& numbers)
+{
+    clear();
+    if (numbers.size() < 5)
+        return 1;
+    
+    int new_nx = (int)numbers[3];
+    int new_ny = (int)numbers[4];
+    if (numbers[2] <= 0.0 || new_nx < 2 || new_ny < 2 ||
+        numbers.size() != 5 + (size_t)new_nx * new_ny)
+        return 1;
+    
+    origin = Vector2d(numbers[0], numbers[1]);
+    cell = numbers[2];
+    nx = new_nx;
+    ny = new_ny;
+    values.assign(numbers.begin() + 5, numbers.end());
+    return 0;
+}
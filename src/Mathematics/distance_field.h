@@ -0,0 +1,69 @@
+//
+//  distance_field.h
+//  Trusses
+//
+
+#ifndef __Trusses__distance_field__
+#define __Trusses__distance_field__
+
+#include <vector>
+#include <iostream>
+#include "vector2d.h"
+
+class EdgeTree;
+
+// Largest number of samples in a field. Fields which would need more
+// are sampled more coarsely.
+#define MAX_FIELD_SAMPLES 4000000
+
+// Signed distance to the boundary of a polygon sampled on a regular
+// grid: negative inside, positive outside. Values between the samples
+// are interpolated bilinearly.
+class DistanceField
+{
+public:
+    DistanceField();
+    
+    bool empty() const {return values.empty();}
+    void clear();
+    
+    // Samples the distance to the edges of the tree on a grid covering
+    // the box [box_min, box_max] and a margin of two cells.
+    void build(const EdgeTree& edges, const Vector2d& box_min,
+               const Vector2d& box_max, double cell_size);
+    
+    // True if p is within the sampled grid
+    bool covers(const Vector2d& p) const;
+    
+    // Interpolated signed distance and its gradient. Only
+    // valid for points covered by the field.
+    double distance(const Vector2d& p) const;
+    Vector2d gradient(const Vector2d& p) const;
+    
+    double cell_size() const {return cell;}
+    
+    // Cell size used by build for a box of this size
+    static double sampled_cell_size(const Vector2d& box_size, double cell_size);
+    
+    // Written as <x0> <y0> <cell size> <nx> <ny> <values...>, with
+    // enough digits to be read back exactly
+    void write(std::ostream& out) const;
+    
+    // Reads the numbers written by write. Returns 0 on success.
+    int read(const std::vector<double>& numbers);
+    
+private:
+    // Position of the sample (0, 0)
+    Vector2d origin;
+    double cell;
+    int nx, ny;
+    
+    // Sample (i, j) is at origin + (i, j) * cell
+    std::vector<float> values;
+    
+    // Cell containing p and the position of p within it
+    void locate(const Vector2d& p, int& i, int& j, double& fx, double& fy) const;
+    double at(int i, int j) const {return values[j * nx + i];}
+};
+
+#endif /* defined(__Trusses__distance_field__) */
@@ -0,0 +1,241 @@
+//
+//  edge_tree.cpp
+//  Trusses
+//
+
+#include "edge_tree.h"
+#include <algorithm>
+#include <cmath>
+#include "various_math.h"
+
+// Largest number of edges in a leaf
+#define LEAF_EDGES 4
+
+// Deeper trees would need more than 2^64 edges
+#define MAX_DEPTH 64
+
+EdgeTree::EdgeTree() {}
+
+void EdgeTree::build(const std::vector<Vector2d>& points)
+{
+    int n = (int)points.size();
+    nodes.clear();
+    start.resize(n);
+    end.resize(n);
+    edge_index.resize(n);
+    sorted_position.resize(n);
+    if (n < 3)
+    {
+        start.clear();
+        end.clear();
+        edge_index.clear();
+        return;
+    }
+    
+    for (int i = 0; i < n; i++)
+    {
+        start[i] = points[i];
+        end[i] = points[(i + 1) % n];
+        edge_index[i] = i;
+    }
+    
+    nodes.reserve(2 * n / LEAF_EDGES + 1);
+    nodes.push_back(Node());
+    build_node(0, 0, n);
+    
+    for (int j = 0; j < n; j++)
+        sorted_position[edge_index[j]] = j;
+}
+
+void EdgeTree::build_node(int node, int first, int last)
+{
+    // Bounding box of the edges
+    Vector2d box_min = start[first];
+    Vector2d box_max = start[first];
+    for (int j = first; j < last; j++)
+    {
+        box_min = Vector2d(min(box_min.x, min(start[j].x, end[j].x)),
+                           min(box_min.y, min(start[j].y, end[j].y)));
+        box_max = Vector2d(max(box_max.x, max(start[j].x, end[j].x)),
+                           max(box_max.y, max(start[j].y, end[j].y)));
+    }
+    nodes[node].box_min = box_min;
+    nodes[node].box_max = box_max;
+    
+    if (last - first <= LEAF_EDGES)
+    {
+        nodes[node].first = first;
+        nodes[node].count = last - first;
+        return;
+    }
+    
+    // Split at the median of the edge midpoints along the longer side
+    bool split_x = box_max.x - box_min.x > box_max.y - box_min.y;
+    std::vector<int> order(last - first);
+    for (int j = first; j < last; j++)
+        order[j - first] = j;
+    int mid = (last - first) / 2;
+    std::nth_element(order.begin(), order.begin() + mid, order.end(), [this, split_x](int a, int b)
+    {
+        Vector2d ca = start[a] + end[a];
+        Vector2d cb = start[b] + end[b];
+        return split_x ? ca.x < cb.x : ca.y < cb.y;
+    });
+    
+    std::vector<Vector2d> new_start(last - first), new_end(last - first);
+    std::vector<int> new_index(last - first);
+    for (int j = 0; j < last - first; j++)
+    {
+        new_start[j] = start[order[j]];
+        new_end[j] = end[order[j]];
+        new_index[j] = edge_index[order[j]];
+    }
+    std::copy(new_start.begin(), new_start.end(), start.begin() + first);
+    std::copy(new_end.begin(), new_end.end(), end.begin() + first);
+    std::copy(new_index.begin(), new_index.end(), edge_index.begin() + first);
+    
+    int children = (int)nodes.size();
+    nodes[node].first = children;
+    nodes[node].count = 0;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    build_node(children, first, first + mid);
+    build_node(children + 1, first + mid, last);
+}
+
+bool EdgeTree::point_inside(const Vector2d& p) const
+{
+    if (nodes.empty())
+        return false;
+    
+    bool inside = false;
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        
+        // The ray can't cross edges below, above or to the left of p
+        if (p.y < node.box_min.y || p.y > node.box_max.y || p.x > node.box_max.x)
+            continue;
+        
+        if (node.count == 0)
+        {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        
+        for (int j = node.first; j < node.first + node.count; j++)
+        {
+            const Vector2d& pi = start[j];
+            const Vector2d& pj = end[j];
+            
+            // The same test as in Polygon::point_inside
+            if ((p.y < pi.y) != (p.y < pj.y))
+            {
+                double x = pj.x - pi.x;
+                double y = pj.y - pi.y;
+                if (y < 0)
+                {
+                    x = -x;
+                    y = -y;
+                }
+                double cross = x * (p.y - pi.y) - y * (p.x - pi.x);
+                if (cross > 0)
+                    inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+bool EdgeTree::first_hit(const Segment& s, int& edge, Vector2d& point, double& t) const
+{
+    if (nodes.empty())
+        return false;
+    
+    Vector2d seg_min(min(s.p1.x, s.p2.x), min(s.p1.y, s.p2.y));
+    Vector2d seg_max(max(s.p1.x, s.p2.x), max(s.p1.y, s.p2.y));
+    Segment segment = s;
+    
+    bool hit = false;
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        if (seg_min.x > node.box_max.x || seg_max.x < node.box_min.x ||
+            seg_min.y > node.box_max.y || seg_max.y < node.box_min.y)
+            continue;
+        
+        if (node.count == 0)
+        {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        
+        for (int j = node.first; j < node.first + node.count; j++)
+        {
+            double t_edge, u;
+            Vector2d intersection;
+            if (!segment.intersect(Segment(start[j], end[j]), intersection, t_edge, u))
+                continue;
+            
+            // Keep the intersection closest to the start of the segment
+            if (!hit || t_edge < t || (t_edge == t && edge_index[j] < edge))
+            {
+                hit = true;
+                t = t_edge;
+                edge = edge_index[j];
+                point = intersection;
+            }
+        }
+    }
+    return hit;
+}
+
+double EdgeTree::distance(const Vector2d& p) const
+{
+    if (nodes.empty())
+        return 0.0;
+    
+    double best2 = -1.0;
+    int stack[MAX_DEPTH];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node& node = nodes[stack[--top]];
+        
+        // Skip the nodes whose boxes are further away than the closest edge
+        double dx = max(0.0, max(node.box_min.x - p.x, p.x - node.box_max.x));
+        double dy = max(0.0, max(node.box_min.y - p.y, p.y - node.box_max.y));
+        if (best2 >= 0.0 && dx * dx + dy * dy >= best2)
+            continue;
+        
+        if (node.count == 0)
+        {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        
+        for (int j = node.first; j < node.first + node.count; j++)
+        {
+            double d2 = (Segment(start[j], end[j]).closest_point(p) - p).abs2();
+            if (best2 < 0.0 || d2 < best2)
+                best2 = d2;
+        }
+    }
+    return std::sqrt(best2);
+}
+
+Segment EdgeTree::edge(int i) const
+{
+    int j = sorted_position[i];
+    return Segment(start[j], end[j]);
+}
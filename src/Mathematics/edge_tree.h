@@ -0,0 +1,67 @@
+//
+//  edge_tree.h
+//  Trusses
+//
+
+#ifndef __Trusses__edge_tree__
+#define __Trusses__edge_tree__
+
+#include <vector>
+#include "vector2d.h"
+#include "segment.h"
+
+// Bounding volume hierarchy over the edges of a polygon, so that
+// containment and intersection queries take O(log n) instead of
+// walking every edge. Edge i goes from points[i] to points[i+1]
+// (the last one back to points[0]). The tree keeps its own copy of
+// the edges, so it has to be rebuilt if the polygon changes.
+class EdgeTree
+{
+public:
+    EdgeTree();
+    
+    void build(const std::vector<Vector2d>& points);
+    
+    bool empty() const {return nodes.empty();}
+    
+    // Same as Polygon::point_inside, but only looks at the edges
+    // which can be crossed by a ray going from p in the +x direction
+    bool point_inside(const Vector2d& p) const;
+    
+    // Finds the edge crossed first by the segment going from s.p1
+    // to s.p2. Returns false if it doesn't cross any edge. t is the
+    // fraction of the segment before the intersection.
+    bool first_hit(const Segment& s, int& edge, Vector2d& point, double& t) const;
+    
+    // Distance from p to the closest edge
+    double distance(const Vector2d& p) const;
+    
+    // The edge as a segment
+    Segment edge(int i) const;
+    
+private:
+    // Leaves have count > 0 and hold edges [first, first + count)
+    // of the sorted edges. Inner nodes have children first and first + 1.
+    struct Node
+    {
+        Vector2d box_min;
+        Vector2d box_max;
+        int first;
+        int count;
+    };
+    
+    std::vector<Node> nodes;
+    
+    // Edges in the order of the leaves
+    std::vector<Vector2d> start;
+    std::vector<Vector2d> end;
+    std::vector<int> edge_index;
+    
+    // Position of each edge in the sorted arrays
+    std::vector<int> sorted_position;
+    
+    // Builds the subtree of node over the sorted edges [first, last)
+    void build_node(int node, int first, int last);
+};
+
+#endif /* defined(__Trusses__edge_tree__) */
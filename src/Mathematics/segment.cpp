@@ -59,5 +59,20 @@ double Segment::dist2(Vector2d& p) const
 
 double Segment::dist(Vector2d& p) const
 {
-    return sqrt(dist(p));
-}
\ No newline at end of file
+    return sqrt(dist2(p));
+}
+
+Vector2d Segment::closest_point(const Vector2d& p) const
+{
+    Vector2d d = p2 - p1;
+    double len2 = d.abs2();
+    if (len2 == 0.0)
+        return p1;
+    
+    double t = ((p - p1) * d) / len2;
+    if (t < 0.0)
+        t = 0.0;
+    else if (t > 1.0)
+        t = 1.0;
+    return p1 + t * d;
+}
@@ -26,6 +26,9 @@ public:
     // The distance between the point and a line defined by the segment.
     double dist2(Vector2d& p) const;
     double dist(Vector2d& p) const;
+    
+    // The point of the segment (not the line) closest to p
+    Vector2d closest_point(const Vector2d& p) const;
 };
 
 #endif /* defined(__Trusses__segment__) */
@@ -8,12 +8,17 @@
 
 #include "vector2d.h"
 
-Vector2d Vector2d::reflect(const Vector2d& normal, const Vector2d& intersection_point)
+template <typename T>
+Vector2<T> Vector2<T>::reflect(const Vector2& normal, const Vector2& intersection_point)
 {
     return *this - 2 * ((*this - intersection_point) * normal) * normal;
 }
 
-Vector2d Vector2d::bisect(const Vector2d& v1, const Vector2d& v2)
+template <typename T>
+Vector2<T> Vector2<T>::bisect(const Vector2& v1, const Vector2& v2)
 {
     return (v1.norm()+ v2.norm()).norm();
-}
\ No newline at end of file
+}
+
+template class Vector2<float>;
+template class Vector2<double>;
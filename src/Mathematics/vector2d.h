@@ -12,29 +12,43 @@
 #include <cmath>
 #include <iostream>
 
-class Vector2d
+// Floating point type of the simulation state. Builds with TRUSSES_FLOAT
+// use float, which halves the memory traffic of large scenes and fits
+// twice as many numbers in a vector register. The static solver and
+// the other accumulations keep using double.
+#ifdef TRUSSES_FLOAT
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
+template <typename T>
+class Vector2
 {
 public:
-    double x;
-    double y;
-    Vector2d() {x = 0.0, y = 0.0;};
-    Vector2d(double a, double b): x(a), y(b) {}
-    Vector2d operator+ (const Vector2d &v) const { return Vector2d(x+v.x, y+v.y); }
-    Vector2d operator- (const Vector2d &v) const { return Vector2d(x-v.x, y-v.y); }
-    friend Vector2d operator- (const Vector2d &v) { return Vector2d(-v.x, -v.y); }
-    Vector2d& operator+= (const Vector2d &v) { x+=v.x; y+=v.y; return *this; }
-    Vector2d& operator-= (const Vector2d &v) { x-=v.x; y-=v.y; return *this; }
-    double operator* (const Vector2d &v) const { return (x*v.x + y*v.y); }
-    friend Vector2d operator* (const double &a, const Vector2d &v) { return Vector2d(v.x*a, v.y*a); }
-    Vector2d operator/ (const double &a) const { return Vector2d(x/a, y/a); }
-    friend Vector2d operator/ (const double &a, const Vector2d &v) { return Vector2d(v.x/a, v.y/a); }
-    double cross(const Vector2d& v) { return x * v.y - y * v.x; }
-    double abs2() const { return (x*x + y*y); }
-    double abs() const { return std::sqrt(this->abs2()); }
-    Vector2d norm() const { double s(this->abs()); if (s==0) return *this; else return Vector2d(x/s, y/s); }
-    friend std::ostream& operator << (std::ostream &out, const Vector2d &v) { out << v.x << ' ' << v.y; return out; }
-    Vector2d reflect(const Vector2d& normal, const Vector2d& intersection_point);
-    static Vector2d bisect(const Vector2d& v1, const Vector2d& v2);
+    T x;
+    T y;
+    Vector2() {x = 0.0, y = 0.0;};
+    Vector2(T a, T b): x(a), y(b) {}
+    Vector2 operator+ (const Vector2 &v) const { return Vector2(x+v.x, y+v.y); }
+    Vector2 operator- (const Vector2 &v) const { return Vector2(x-v.x, y-v.y); }
+    friend Vector2 operator- (const Vector2 &v) { return Vector2(-v.x, -v.y); }
+    Vector2& operator+= (const Vector2 &v) { x+=v.x; y+=v.y; return *this; }
+    Vector2& operator-= (const Vector2 &v) { x-=v.x; y-=v.y; return *this; }
+    T operator* (const Vector2 &v) const { return (x*v.x + y*v.y); }
+    friend Vector2 operator* (const T &a, const Vector2 &v) { return Vector2(v.x*a, v.y*a); }
+    Vector2 operator/ (const T &a) const { return Vector2(x/a, y/a); }
+    friend Vector2 operator/ (const T &a, const Vector2 &v) { return Vector2(v.x/a, v.y/a); }
+    T cross(const Vector2& v) { return x * v.y - y * v.x; }
+    T abs2() const { return (x*x + y*y); }
+    T abs() const { return std::sqrt(this->abs2()); }
+    Vector2 norm() const { T s(this->abs()); if (s==0) return *this; else return Vector2(x/s, y/s); }
+    friend std::ostream& operator << (std::ostream &out, const Vector2 &v) { out << v.x << ' ' << v.y; return out; }
+    Vector2 reflect(const Vector2& normal, const Vector2& intersection_point);
+    static Vector2 bisect(const Vector2& v1, const Vector2& v2);
 };
 
+// Vector of the simulation
+typedef Vector2<Real> Vector2d;
+
 #endif /* defined(__Trusses__vector2d__) */
@@ -0,0 +1,288 @@
+//
+//  constraint_table.cpp
+//  Trusses
+//
+
+#include "constraint_table.h"
+#include <cmath>
+#include "particle.h"
+#include "bar.h"
+#include "material.h"
+#include "islands.h"
+
+ConstraintTable constraints;
+
+ConstraintTable::ConstraintTable()
+{
+    up_to_date = false;
+    by_island = false;
+    colour_start.push_back(0);
+}
+
+void ConstraintTable::set_island_order(bool state)
+{
+    if (state != by_island)
+        up_to_date = false;
+    by_island = state;
+}
+
+bool ConstraintTable::island_order() const
+{
+    return by_island;
+}
+
+void ConstraintTable::invalidate()
+{
+    up_to_date = false;
+}
+
+bool ConstraintTable::valid() const
+{
+    return up_to_date;
+}
+
+// Bars of sleeping islands and bars between fixed particles
+// don't need to be relaxed
+static bool is_active(const Bar& b)
+{
+    int i1 = particles.index(b.p1_id);
+    int i2 = particles.index(b.p2_id);
+    return (!particle_store.fixed[i1] && !particle_store.sleeping[i1]) ||
+           (!particle_store.fixed[i2] && !particle_store.sleeping[i2]);
+}
+
+void ConstraintTable::rebuild()
+{
+    std::vector<char> active(bars.size());
+    unsigned int n = 0;
+    for (int j = 0; j < bars.size(); j++)
+    {
+        active[j] = is_active(bars.at(j));
+        n += active[j];
+    }
+    
+    p1.resize(n);
+    p2.resize(n);
+    r0.resize(n);
+    stiffness.resize(n);
+    compliance.resize(n);
+    material.resize(n);
+    lambda.assign(n, 0.0);
+    inv_mass1.resize(n);
+    inv_mass2.resize(n);
+    bar_id.resize(n);
+    
+    // Batch of each bar. In the island order the batches of
+    // each island follow one another.
+    std::vector<unsigned int> batch(bars.size(), 0);
+    unsigned int n_islands = by_island ? islands.size() : 1;
+    std::vector<unsigned int> island_colours(n_islands, 0);
+    for (int j = 0; j < bars.size(); j++)
+    {
+        if (!active[j])
+            continue;
+        const Bar& b = bars.at(j);
+        unsigned int k = 0;
+        if (by_island)
+        {
+            // One of the particles is free and awake
+            int i1 = particles.index(b.p1_id);
+            k = islands.island_of(i1) != -1 ? islands.island_of(i1) : islands.island_of(particles.index(b.p2_id));
+        }
+        batch[j] = k;
+        if (b.colour + 1 > island_colours[k])
+            island_colours[k] = b.colour + 1;
+    }
+    
+    // First batch of each island
+    island_batch.assign(n_islands + 1, 0);
+    for (unsigned int k = 0; k < n_islands; k++)
+        island_batch[k+1] = island_batch[k] + island_colours[k];
+    for (int j = 0; j < bars.size(); j++)
+        if (active[j])
+            batch[j] = island_batch[batch[j]] + bars.at(j).colour;
+    
+    // Count the bars of each batch
+    colour_start.assign(island_batch.back() + 1, 0);
+    if (!by_island)
+        island_batch.clear();
+    for (int j = 0; j < bars.size(); j++)
+        if (active[j])
+            colour_start[batch[j] + 1]++;
+    for (unsigned int c = 1; c < colour_start.size(); c++)
+        colour_start[c] += colour_start[c-1];
+    
+    // Place each bar in its batch
+    std::vector<unsigned int> position(colour_start.begin(), colour_start.end() - 1);
+    for (int j = 0; j < bars.size(); j++)
+    {
+        if (!active[j])
+            continue;
+        const Bar& b = bars.at(j);
+        unsigned int i = position[batch[j]]++;
+        int i1 = particles.index(b.p1_id);
+        int i2 = particles.index(b.p2_id);
+        
+        p1[i] = i1;
+        p2[i] = i2;
+        r0[i] = b.r0;
+        stiffness[i] = 1.0;
+        compliance[i] = b.get_compliance();
+        material[i] = b.get_material();
+        inv_mass1[i] = particle_store.fixed[i1] ? 0.0 : particle_store.inv_mass[i1];
+        inv_mass2[i] = particle_store.fixed[i2] ? 0.0 : particle_store.inv_mass[i2];
+        bar_id[i] = b.id_;
+    }
+    
+    up_to_date = true;
+}
+
+void ConstraintTable::remove_bars(const std::vector<char>& removed_bars)
+{
+    if (!up_to_date)
+        return;
+    
+    // Compact each batch in place, batches only shrink
+    unsigned int n = 0;
+    unsigned int batch_begin = colour_start[0];
+    for (unsigned int c = 0; c < colours(); c++)
+    {
+        unsigned int batch_end = colour_start[c+1];
+        colour_start[c] = n;
+        for (unsigned int k = batch_begin; k < batch_end; k++)
+        {
+            if (bar_id[k] < removed_bars.size() && removed_bars[bar_id[k]])
+                continue;
+            p1[n] = p1[k];
+            p2[n] = p2[k];
+            r0[n] = r0[k];
+            stiffness[n] = stiffness[k];
+            compliance[n] = compliance[k];
+            material[n] = material[k];
+            lambda[n] = lambda[k];
+            inv_mass1[n] = particle_store.fixed[p1[k]] ? 0.0 : particle_store.inv_mass[p1[k]];
+            inv_mass2[n] = particle_store.fixed[p2[k]] ? 0.0 : particle_store.inv_mass[p2[k]];
+            bar_id[n] = bar_id[k];
+            n++;
+        }
+        batch_begin = batch_end;
+    }
+    colour_start.back() = n;
+    
+    p1.resize(n);
+    p2.resize(n);
+    r0.resize(n);
+    stiffness.resize(n);
+    compliance.resize(n);
+    material.resize(n);
+    lambda.resize(n);
+    inv_mass1.resize(n);
+    inv_mass2.resize(n);
+    bar_id.resize(n);
+}
+
+double ConstraintTable::relax(ParticleStore& store, unsigned int begin, unsigned int end) const
+{
+    Vector2d* pos = store.position.data();
+    double max_residual = 0.0;
+    
+    for (unsigned int k = begin; k < end; k++)
+    {
+        Real w1 = inv_mass1[k];
+        Real w2 = inv_mass2[k];
+        Real w = w1 + w2;
+        
+        Vector2d& pos1 = pos[p1[k]];
+        Vector2d& pos2 = pos[p2[k]];
+        Vector2d d = pos2 - pos1;
+        Real len = d.abs();
+        
+        // Both particles are fixed or on top of each other
+        if (w == 0.0 || len == 0.0)
+            continue;
+        
+        double residual = std::fabs(len - r0[k]) / r0[k];
+        if (residual > max_residual)
+            max_residual = residual;
+        
+        // Move the particles along the bar in proportion
+        // to their inverse masses
+        Real s = stiffness[k] * (len - r0[k]) / (len * w);
+        pos1 += (w1 * s) * d;
+        pos2 -= (w2 * s) * d;
+    }
+    return max_residual;
+}
+
+void ConstraintTable::reset_multipliers()
+{
+    lambda.assign(size(), 0.0);
+}
+
+void ConstraintTable::reset_multipliers(unsigned int begin, unsigned int end)
+{
+    for (unsigned int k = begin; k < end; k++)
+        lambda[k] = 0.0;
+}
+
+double ConstraintTable::relax_xpbd(ParticleStore& store, unsigned int begin, unsigned int end,
+                                   double inv_dt2)
+{
+    Vector2d* pos = store.position.data();
+    double max_residual = 0.0;
+    
+    for (unsigned int k = begin; k < end; k++)
+    {
+        Real w1 = inv_mass1[k];
+        Real w2 = inv_mass2[k];
+        Real w = w1 + w2;
+        Vector2d& pos1 = pos[p1[k]];
+        Vector2d& pos2 = pos[p2[k]];
+        Vector2d d = pos2 - pos1;
+        Real len = d.abs();
+        
+        if (w == 0.0 || len == 0.0)
+            continue;
+        
+        Real c = len - r0[k];
+        
+        // Compliance scaled by the time step, so that the stiffness
+        // depends neither on the number of passes nor on dt
+        Real alpha = compliance[k] * inv_dt2;
+        
+        // A loaded compliant bar is strained at equilibrium, so it's the
+        // constraint residual which goes to zero, not the strain
+        double residual = std::fabs(c + alpha * lambda[k]) / r0[k];
+        if (residual > max_residual)
+            max_residual = residual;
+        
+        Real d_lambda = (-c - alpha * lambda[k]) / (w + alpha);
+        lambda[k] += d_lambda;
+        
+        Vector2d correction = (d_lambda / len) * d;
+        pos1 -= w1 * correction;
+        pos2 += w2 * correction;
+    }
+    return max_residual;
+}
+
+void ConstraintTable::find_fractured(const ParticleStore& store, std::vector<int>& fractured) const
+{
+    find_fractured(store, 0, size(), fractured);
+}
+
+void ConstraintTable::find_fractured(const ParticleStore& store, unsigned int begin,
+                                     unsigned int end, std::vector<int>& fractured) const
+{
+    const Vector2d* pos = store.position.data();
+    const double* tension_limit = materials.tension_limit.data();
+    const double* compression_limit = materials.compression_limit.data();
+    
+    for (unsigned int k = begin; k < end; k++)
+    {
+        double len = (pos[p2[k]] - pos[p1[k]]).abs();
+        double strain = (len - r0[k]) / r0[k];
+        if (strain > tension_limit[material[k]] || strain < -compression_limit[material[k]])
+            fractured.push_back(bar_id[k]);
+    }
+}
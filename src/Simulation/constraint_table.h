@@ -0,0 +1,119 @@
+//
+//  constraint_table.h
+//  Trusses
+//
+
+#ifndef __Trusses__constraint_table__
+#define __Trusses__constraint_table__
+
+#include <vector>
+#include "vector2d.h"
+
+class ParticleStore;
+
+// Flat copy of the constraints imposed by bars, compiled for the
+// relaxation loop. Particles are referred to by their index in the
+// particle store, so no id lookups are needed while relaxing. The table
+// has to be rebuilt whenever the topology changes, which is signalled
+// by invalidate().
+//
+// Constraints are sorted by the colour of their bars. Bars of the same
+// colour never share a particle, so each colour batch can be relaxed
+// in parallel. In the island order the constraints are sorted by the
+// island of their particles first (see Islands), so that each island
+// has its own colour batches.
+class ConstraintTable
+{
+    friend class Journal;
+public:
+    ConstraintTable();
+    
+    // Indices of the particles in the particle store
+    std::vector<int> p1;
+    std::vector<int> p2;
+    
+    // Equilibrium length of the bar
+    std::vector<Real> r0;
+    
+    // PBD stiffness, and XPBD compliance from the material of the bar
+    std::vector<Real> stiffness;
+    std::vector<Real> compliance;
+    
+    // Index of the material of the bar, for its strength limits
+    std::vector<unsigned char> material;
+    
+    // Lagrange multipliers of the XPBD solver, accumulated
+    // over the passes of one step
+    std::vector<Real> lambda;
+    
+    // Inverse masses of the particles, zero for fixed particles
+    std::vector<Real> inv_mass1;
+    std::vector<Real> inv_mass2;
+    
+    // Id of the bar this constraint was compiled from
+    std::vector<int> bar_id;
+    
+    // Constraints of colour batch c are in [colour_start[c], colour_start[c+1])
+    std::vector<unsigned int> colour_start;
+    
+    // In the island order the colour batches of island k are
+    // [island_batch[k], island_batch[k+1]), otherwise it's empty
+    std::vector<unsigned int> island_batch;
+    
+    unsigned int size() const {return (unsigned int)p1.size();}
+    unsigned int colours() const {return (unsigned int)colour_start.size() - 1;}
+    
+    // Sorts the constraints by island at the next rebuild
+    void set_island_order(bool state);
+    bool island_order() const;
+    
+    // Marks the table as out of date. Should be called whenever bars,
+    // particles, masses or fixed flags change.
+    void invalidate();
+    bool valid() const;
+    
+    // Compiles the table from bars and particle_store. Bars
+    // which can't move (see Islands) are left out.
+    void rebuild();
+    
+    // Drops the constraints of the bars whose ids are marked in
+    // removed_bars, keeping the order of the others. Removing bars
+    // never breaks the colouring, so the table stays valid without
+    // a rebuild. The inverse masses are read again from particle_store,
+    // as the joints of the removed bars are lumped again. Does nothing
+    // if the table is out of date.
+    void remove_bars(const std::vector<char>& removed_bars);
+    
+    // One relaxation pass over the constraints in [begin, end). Returns
+    // the largest absolute strain found before the correction.
+    double relax(ParticleStore& store, unsigned int begin, unsigned int end) const;
+    
+    // Zeroes the Lagrange multipliers. Called at the start of each step.
+    void reset_multipliers();
+    
+    // One XPBD pass over [begin, end), where inv_dt2 is 1/dt^2 of the
+    // simulation step. Returns the largest constraint residual
+    // |c + alpha lambda| / r0, which is zero at equilibrium even for
+    // compliant bars under load.
+    double relax_xpbd(ParticleStore& store, unsigned int begin, unsigned int end,
+                      double inv_dt2);
+    
+    // Appends ids of the bars whose strain is beyond the tension or
+    // compression limit of their material
+    void find_fractured(const ParticleStore& store, std::vector<int>& fractured) const;
+    
+    // The same for the constraints in [begin, end)
+    void find_fractured(const ParticleStore& store, unsigned int begin,
+                        unsigned int end, std::vector<int>& fractured) const;
+    
+    // Zeroes the Lagrange multipliers of the constraints in [begin, end)
+    void reset_multipliers(unsigned int begin, unsigned int end);
+    
+private:
+    bool up_to_date;
+    bool by_island;
+};
+
+extern ConstraintTable constraints;
+
+#endif /* defined(__Trusses__constraint_table__) */
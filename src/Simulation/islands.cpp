@@ -0,0 +1,205 @@
+//
+//  islands.cpp
+//  Trusses
+//
+
+#include "islands.h"
+#include "particle.h"
+#include "bar.h"
+#include "constraint_table.h"
+
+Islands islands;
+
+// Root of the set containing i, with path halving
+static int find_root(std::vector<int>& parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+Islands::Islands()
+{
+    enabled = true;
+    up_to_date = false;
+    island_start.push_back(0);
+}
+
+void Islands::invalidate()
+{
+    up_to_date = false;
+}
+
+bool Islands::valid() const
+{
+    return up_to_date;
+}
+
+void Islands::rebuild()
+{
+    const ParticleStore& store = particle_store;
+    unsigned int n = store.size();
+    
+    // Join the particles connected by bars
+    std::vector<int> parent(n);
+    for (unsigned int i = 0; i < n; i++)
+        parent[i] = i;
+    for (int k = 0; k < bars.size(); k++)
+    {
+        int i1 = particles.index(bars.at(k).p1_id);
+        int i2 = particles.index(bars.at(k).p2_id);
+        if (store.fixed[i1] || store.fixed[i2])
+            continue;
+        
+        int r1 = find_root(parent, i1);
+        int r2 = find_root(parent, i2);
+        if (r1 != r2)
+            parent[r1] = r2;
+    }
+    
+    // Number the islands and count their particles
+    std::vector<int> root_island(n, -1);
+    island.assign(n, -1);
+    island_start.assign(1, 0);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (store.fixed[i])
+            continue;
+        int root = find_root(parent, i);
+        if (root_island[root] == -1)
+        {
+            root_island[root] = (int)island_start.size() - 1;
+            island_start.push_back(0);
+        }
+        island[i] = root_island[root];
+        island_start[island[i] + 1]++;
+    }
+    for (unsigned int k = 1; k < island_start.size(); k++)
+        island_start[k] += island_start[k-1];
+    
+    // Group the members by island. An island sleeps if all
+    // its particles were asleep before.
+    std::vector<int> position(island_start.begin(), island_start.end() - 1);
+    members.resize(island_start.back());
+    sleeping.assign(size(), true);
+    quiet_steps.assign(size(), 0);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (island[i] == -1)
+        {
+            particle_store.sleeping[i] = false;
+            continue;
+        }
+        members[position[island[i]]++] = i;
+        if (!store.sleeping[i])
+            sleeping[island[i]] = false;
+    }
+    for (unsigned int j = 0; j < members.size(); j++)
+        particle_store.sleeping[members[j]] = sleeping[island[members[j]]];
+    
+    constraints.invalidate();
+    up_to_date = true;
+}
+
+void Islands::update_sleep(double dt)
+{
+    if (!enabled)
+        return;
+    
+    const ParticleStore& store = particle_store;
+    double threshold = SLEEP_VELOCITY * SLEEP_VELOCITY * dt * dt;
+    for (unsigned int k = 0; k < size(); k++)
+    {
+        if (sleeping[k])
+            continue;
+        
+        // Mean square displacement in the last step, weighted by mass
+        double energy = 0.0;
+        double mass = 0.0;
+        for (int j = island_start[k]; j < island_start[k+1]; j++)
+        {
+            int i = members[j];
+            double m = 1.0 / store.inv_mass[i];
+            energy += m * (store.position[i] - store.prev_position[i]).abs2();
+            mass += m;
+        }
+        
+        // Particles being dragged never sleep
+        bool dragged = false;
+        for (int j = island_start[k]; j < island_start[k+1] && !dragged; j++)
+            dragged = store.acceleration[members[j]].abs2() > 0.0;
+        
+        if (dragged || energy > threshold * mass)
+            quiet_steps[k] = 0;
+        else if (++quiet_steps[k] >= SLEEP_STEPS)
+            set_asleep(k, true);
+    }
+}
+
+void Islands::wake(unsigned int i)
+{
+    // The island will be awake after the rebuild
+    if (!up_to_date)
+    {
+        if (i < particle_store.size())
+            particle_store.sleeping[i] = false;
+        return;
+    }
+    if (i >= island.size() || island[i] == -1)
+        return;
+    
+    int k = island[i];
+    quiet_steps[k] = 0;
+    if (sleeping[k])
+        set_asleep(k, false);
+}
+
+void Islands::wake_all()
+{
+    if (!up_to_date)
+        return;
+    for (unsigned int k = 0; k < size(); k++)
+    {
+        quiet_steps[k] = 0;
+        if (sleeping[k])
+            set_asleep(k, false);
+    }
+}
+
+int Islands::island_of(unsigned int i) const
+{
+    return island[i];
+}
+
+bool Islands::asleep(unsigned int k) const
+{
+    return sleeping[k];
+}
+
+unsigned int Islands::sleeping_particles() const
+{
+    unsigned int n = 0;
+    for (unsigned int k = 0; k < size(); k++)
+        if (sleeping[k])
+            n += island_start[k+1] - island_start[k];
+    return n;
+}
+
+void Islands::set_asleep(unsigned int k, bool state)
+{
+    sleeping[k] = state;
+    for (int j = island_start[k]; j < island_start[k+1]; j++)
+    {
+        int i = members[j];
+        particle_store.sleeping[i] = state;
+        
+        // Sleeping particles are at rest
+        particle_store.prev_position[i] = particle_store.position[i];
+    }
+    
+    // The bars of sleeping islands are left out of the table
+    constraints.invalidate();
+}
@@ -0,0 +1,81 @@
+//
+//  islands.h
+//  Trusses
+//
+
+#ifndef __Trusses__islands__
+#define __Trusses__islands__
+
+#include <vector>
+
+// Islands stay awake while their mean square speed
+// is above SLEEP_VELOCITY^2 (in m/s)
+#define SLEEP_VELOCITY 0.1
+
+// Number of consecutive quiet steps after which an island falls asleep
+#define SLEEP_STEPS 100
+
+// Groups of free particles connected by bars. Fixed particles don't
+// transmit any motion, so they don't join islands together and belong
+// to no island.
+//
+// An island which stays at rest for SLEEP_STEPS falls asleep: its
+// particles are skipped by the integration and obstacle collisions,
+// and its bars are left out of the constraint table. Islands are woken
+// up by Particle::wake (dragging, editing the particles or destroying
+// their bars).
+class Islands
+{
+    friend class Journal;
+public:
+    Islands();
+    
+    // If false, islands never fall asleep
+    bool enabled;
+    
+    // Marks the islands as out of date. Should be called whenever
+    // particles or bars are added or removed, or particles are fixed.
+    void invalidate();
+    bool valid() const;
+    
+    // Finds the islands with union-find over the bars. A new island
+    // is asleep only if all its particles were asleep.
+    void rebuild();
+    
+    // Puts the islands which have been at rest for long enough to
+    // sleep. Called after each simulation step of length dt (in seconds).
+    void update_sleep(double dt);
+    
+    // Wakes up the island of the particle at index i of particle_store
+    void wake(unsigned int i);
+    void wake_all();
+    
+    unsigned int size() const {return (unsigned int)island_start.size() - 1;}
+    
+    // Island of the particle at index i of particle_store,
+    // -1 for fixed particles
+    int island_of(unsigned int i) const;
+    
+    bool asleep(unsigned int island) const;
+    
+    // Number of particles in sleeping islands
+    unsigned int sleeping_particles() const;
+    
+    // Store indices of the particles of island k are
+    // members[island_start[k]] ... members[island_start[k+1] - 1]
+    std::vector<int> island_start;
+    std::vector<int> members;
+    
+private:
+    bool up_to_date;
+    
+    std::vector<int> island;
+    std::vector<int> quiet_steps;
+    std::vector<char> sleeping;
+    
+    void set_asleep(unsigned int k, bool state);
+};
+
+extern Islands islands;
+
+#endif /* defined(__Trusses__islands__) */
@@ -0,0 +1,126 @@
+//
+//  profiler.cpp
+//  Trusses
+//
+
+#include "profiler.h"
+#include <chrono>
+#include "timeline.h"
+
+Profiler profiler;
+
+unsigned long long int nanosecond_time()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::Profiler()
+{
+    enabled = false;
+    history.assign(PROFILE_PHASES * PROFILE_FRAMES, 0);
+    for (int i = 0; i < PROFILE_PHASES; i++)
+    {
+        current[i] = 0;
+        sums[i] = 0;
+    }
+    frame = 0;
+    recorded_frames = 0;
+    csv_frame = 0;
+}
+
+void Profiler::add(ProfilePhase phase, unsigned long long int ns)
+{
+    current[phase].fetch_add(ns, std::memory_order_relaxed);
+}
+
+void Profiler::end_frame()
+{
+    if (!enabled)
+        return;
+    
+    if (csv.is_open())
+        csv << csv_frame++;
+    
+    for (int i = 0; i < PROFILE_PHASES; i++)
+    {
+        unsigned long long int ns = current[i].exchange(0);
+        
+        // Replace the oldest frame in the running sum
+        unsigned long long int& old = history[i * PROFILE_FRAMES + frame];
+        sums[i] += ns - old;
+        old = ns;
+        
+        if (csv.is_open())
+            csv << ',' << ns / 1000000.0;
+    }
+    if (csv.is_open())
+        csv << '\n';
+    
+    frame = (frame + 1) % PROFILE_FRAMES;
+    if (recorded_frames < PROFILE_FRAMES)
+        recorded_frames++;
+}
+
+double Profiler::average_ms(ProfilePhase phase) const
+{
+    if (recorded_frames == 0)
+        return 0.0;
+    return sums[phase] / (1000000.0 * recorded_frames);
+}
+
+const char* Profiler::phase_name(ProfilePhase phase)
+{
+    const char* names[PROFILE_PHASES] =
+    {
+        "integration", "relaxation", "collision", "fracture", "culling", "picking",
+        "render_grid", "render_obstacles", "render_particles", "render_bars",
+        "render_tool", "render_ui"
+    };
+    return names[phase];
+}
+
+int Profiler::open_csv(const std::string& filename)
+{
+    close_csv();
+    csv.open(filename.c_str());
+    if (!csv.is_open())
+        return 1;
+    
+    csv << "frame";
+    for (int i = 0; i < PROFILE_PHASES; i++)
+        csv << ',' << phase_name((ProfilePhase)i);
+    csv << '\n';
+    csv_frame = 0;
+    return 0;
+}
+
+void Profiler::close_csv()
+{
+    if (csv.is_open())
+        csv.close();
+}
+
+bool Profiler::writing_csv() const
+{
+    return csv.is_open();
+}
+
+ScopedTimer::ScopedTimer(ProfilePhase phase) : phase(phase)
+{
+    profiling = profiler.enabled;
+    tracing = timeline.enabled;
+    if (profiling || tracing)
+        start = nanosecond_time();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    if (!profiling && !tracing)
+        return;
+    unsigned long long int duration = nanosecond_time() - start;
+    if (profiling)
+        profiler.add(phase, duration);
+    if (tracing)
+        timeline.record(Profiler::phase_name(phase), start, duration);
+}
@@ -0,0 +1,99 @@
+//
+//  profiler.h
+//  Trusses
+//
+
+#ifndef __Trusses__profiler__
+#define __Trusses__profiler__
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <atomic>
+
+// Number of frames the averages shown by the overlay are taken over
+#define PROFILE_FRAMES 60
+
+enum ProfilePhase
+{
+    PHASE_INTEGRATION,
+    PHASE_RELAXATION,
+    PHASE_COLLISION,
+    PHASE_FRACTURE,
+    PHASE_CULLING,
+    PHASE_PICKING,
+    PHASE_RENDER_GRID,
+    PHASE_RENDER_OBSTACLES,
+    PHASE_RENDER_PARTICLES,
+    PHASE_RENDER_BARS,
+    PHASE_RENDER_TOOL,
+    PHASE_RENDER_UI,
+    PROFILE_PHASES
+};
+
+// Time spent in each phase of a frame, measured with ScopedTimer.
+// Phases timed on several threads at once (e.g. by the island solver)
+// add up the time of all the threads. When the profiler is disabled
+// the timers don't read the clock at all.
+class Profiler
+{
+public:
+    Profiler();
+    
+    // Off by default. Switched by the interface while the simulation
+    // thread and the workers of the pool read it.
+    std::atomic<bool> enabled;
+    
+    // Adds the time (in nanoseconds) to the phase of the current frame.
+    // Can be called from any thread.
+    void add(ProfilePhase phase, unsigned long long int ns);
+    
+    // Closes the current frame: keeps its times for the averages
+    // and writes them to the CSV file if one is open
+    void end_frame();
+    
+    // Average time of the phase over the last PROFILE_FRAMES frames (in ms)
+    double average_ms(ProfilePhase phase) const;
+    
+    static const char* phase_name(ProfilePhase phase);
+    
+    // Streams the times of every frame to the file, one line per frame
+    // in milliseconds. Returns 1 if the file couldn't be opened.
+    int open_csv(const std::string& filename);
+    void close_csv();
+    bool writing_csv() const;
+    
+private:
+    std::atomic<unsigned long long int> current[PROFILE_PHASES];
+    
+    // Times of the last frames (in ns), PROFILE_FRAMES per phase
+    std::vector<unsigned long long int> history;
+    unsigned long long int sums[PROFILE_PHASES];
+    unsigned int frame;
+    unsigned int recorded_frames;
+    
+    std::ofstream csv;
+    unsigned long long int csv_frame;
+};
+
+extern Profiler profiler;
+
+// Adds the time between its construction and destruction to the phase.
+// It's also recorded as a span of the timeline if that is enabled.
+class ScopedTimer
+{
+public:
+    ScopedTimer(ProfilePhase phase);
+    ~ScopedTimer();
+    
+private:
+    ProfilePhase phase;
+    bool profiling;
+    bool tracing;
+    unsigned long long int start;
+};
+
+// Monotonic time in nanoseconds
+unsigned long long int nanosecond_time();
+
+#endif /* defined(__Trusses__profiler__) */
@@ -0,0 +1,257 @@
+//
+//  relax_kernels.cpp
+//  Trusses
+//
+
+#include "relax_kernels.h"
+#include "constraint_table.h"
+#include "particle_store.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+double relax_scalar(const ConstraintTable& table, ParticleStore& store,
+                    unsigned int begin, unsigned int end)
+{
+    return table.relax(store, begin, end);
+}
+
+#ifdef X86_DISPATCH
+
+bool avx2_supported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+#ifndef TRUSSES_FLOAT
+
+// Loads the positions of particles a, b, c and d, and returns
+// x = (a.x, c.x, b.x, d.x) and y = (a.y, c.y, b.y, d.y)
+__attribute__((target("avx2,fma")))
+static inline void load_positions(const double* pos, int a, int b, int c, int d,
+                                  __m256d& x, __m256d& y)
+{
+    __m256d ab = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(pos + 2*a)), _mm_loadu_pd(pos + 2*b), 1);
+    __m256d cd = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_loadu_pd(pos + 2*c)), _mm_loadu_pd(pos + 2*d), 1);
+    x = _mm256_unpacklo_pd(ab, cd);
+    y = _mm256_unpackhi_pd(ab, cd);
+}
+
+// The inverse of load_positions
+__attribute__((target("avx2,fma")))
+static inline void store_positions(double* pos, int a, int b, int c, int d,
+                                   __m256d x, __m256d y)
+{
+    __m256d ab = _mm256_unpacklo_pd(x, y);
+    __m256d cd = _mm256_unpackhi_pd(x, y);
+    _mm_storeu_pd(pos + 2*a, _mm256_castpd256_pd128(ab));
+    _mm_storeu_pd(pos + 2*b, _mm256_extractf128_pd(ab, 1));
+    _mm_storeu_pd(pos + 2*c, _mm256_castpd256_pd128(cd));
+    _mm_storeu_pd(pos + 2*d, _mm256_extractf128_pd(cd, 1));
+}
+
+// Loads four consecutive values in the order used by load_positions
+__attribute__((target("avx2,fma")))
+static inline __m256d load_shuffled(const double* v)
+{
+    return _mm256_permute4x64_pd(_mm256_loadu_pd(v), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Compiled for AVX2 regardless of the flags of the rest of the build.
+// The same arithmetic as ConstraintTable::relax for four bars at a time.
+__attribute__((target("avx2,fma")))
+double relax_avx2(const ConstraintTable& table, ParticleStore& store,
+                  unsigned int begin, unsigned int end)
+{
+    if (end < begin + 4)
+        return table.relax(store, begin, end);
+    
+    // Vector2d is just two doubles, so the positions can be treated
+    // as an array of doubles: x at 2*i, y at 2*i+1
+    double* pos = &store.position[0].x;
+    const int* p1 = &table.p1[0];
+    const int* p2 = &table.p2[0];
+    
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    __m256d max_residual = zero;
+    unsigned int k = begin;
+    for (; k + 4 <= end; k += 4)
+    {
+        __m256d x1, y1, x2, y2;
+        load_positions(pos, p1[k], p1[k+1], p1[k+2], p1[k+3], x1, y1);
+        load_positions(pos, p2[k], p2[k+1], p2[k+2], p2[k+3], x2, y2);
+        
+        __m256d dx = _mm256_sub_pd(x2, x1);
+        __m256d dy = _mm256_sub_pd(y2, y1);
+        __m256d len = _mm256_sqrt_pd(_mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy)));
+        
+        __m256d w1 = load_shuffled(&table.inv_mass1[k]);
+        __m256d w2 = load_shuffled(&table.inv_mass2[k]);
+        __m256d r0 = load_shuffled(&table.r0[k]);
+        __m256d stiffness = load_shuffled(&table.stiffness[k]);
+        
+        // Skip the bars with both particles fixed or with zero length
+        __m256d denominator = _mm256_mul_pd(len, _mm256_add_pd(w1, w2));
+        __m256d valid = _mm256_cmp_pd(denominator, zero, _CMP_NEQ_OQ);
+        __m256d s = _mm256_div_pd(_mm256_mul_pd(stiffness, _mm256_sub_pd(len, r0)), denominator);
+        s = _mm256_and_pd(s, valid);
+        
+        __m256d residual = _mm256_andnot_pd(sign_bit, _mm256_div_pd(_mm256_sub_pd(len, r0), r0));
+        max_residual = _mm256_max_pd(max_residual, _mm256_and_pd(residual, valid));
+        
+        __m256d s1 = _mm256_mul_pd(w1, s);
+        __m256d s2 = _mm256_mul_pd(w2, s);
+        
+        // The bars don't share particles, so the order of the stores doesn't matter
+        store_positions(pos, p1[k], p1[k+1], p1[k+2], p1[k+3],
+                        _mm256_fmadd_pd(s1, dx, x1), _mm256_fmadd_pd(s1, dy, y1));
+        store_positions(pos, p2[k], p2[k+1], p2[k+2], p2[k+3],
+                        _mm256_fnmadd_pd(s2, dx, x2), _mm256_fnmadd_pd(s2, dy, y2));
+    }
+    
+    // The remaining bars
+    double residuals[4];
+    _mm256_storeu_pd(residuals, max_residual);
+    double result = table.relax(store, k, end);
+    for (int l = 0; l < 4; l++)
+        if (residuals[l] > result)
+            result = residuals[l];
+    return result;
+}
+
+#else
+
+// Loads the positions of eight particles, each x and y pair as one
+// 64-bit gather, and returns x = (x0, ..., x7) and y = (y0, ..., y7)
+__attribute__((target("avx2,fma")))
+static inline void load_positions(const float* pos, const int* indices, __m256& x, __m256& y)
+{
+    __m256i i = _mm256_loadu_si256((const __m256i*)indices);
+    
+    // The unmasked gather leaves its source undefined, which GCC warns
+    // about, so every lane is gathered over zeros instead.
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    __m256 lo = _mm256_castpd_ps(_mm256_mask_i32gather_pd(zero, (const double*)pos, _mm256_castsi256_si128(i), all, 8));
+    __m256 hi = _mm256_castpd_ps(_mm256_mask_i32gather_pd(zero, (const double*)pos, _mm256_extracti128_si256(i, 1), all, 8));
+    
+    // (x0, x1, x4, x5, x2, x3, x6, x7) back into order
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    x = _mm256_permutevar8x32_ps(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), order);
+    y = _mm256_permutevar8x32_ps(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)), order);
+}
+
+// The inverse of load_positions, AVX2 can't scatter so each pair is stored
+__attribute__((target("avx2,fma")))
+static inline void store_positions(float* pos, const int* indices, __m256 x, __m256 y)
+{
+    // (x0, y0, x1, y1, x4, y4, x5, y5) and (x2, y2, x3, y3, x6, y6, x7, y7)
+    __m256 a = _mm256_unpacklo_ps(x, y);
+    __m256 b = _mm256_unpackhi_ps(x, y);
+    __m128 a0 = _mm256_castps256_ps128(a);
+    __m128 a1 = _mm256_extractf128_ps(a, 1);
+    __m128 b0 = _mm256_castps256_ps128(b);
+    __m128 b1 = _mm256_extractf128_ps(b, 1);
+    _mm_storel_pi((__m64*)(pos + 2*indices[0]), a0);
+    _mm_storeh_pi((__m64*)(pos + 2*indices[1]), a0);
+    _mm_storel_pi((__m64*)(pos + 2*indices[2]), b0);
+    _mm_storeh_pi((__m64*)(pos + 2*indices[3]), b0);
+    _mm_storel_pi((__m64*)(pos + 2*indices[4]), a1);
+    _mm_storeh_pi((__m64*)(pos + 2*indices[5]), a1);
+    _mm_storel_pi((__m64*)(pos + 2*indices[6]), b1);
+    _mm_storeh_pi((__m64*)(pos + 2*indices[7]), b1);
+}
+
+// In single precision a register holds eight bars. The positions
+// are put back in the order of the table, so it needs no shuffling.
+__attribute__((target("avx2,fma")))
+double relax_avx2(const ConstraintTable& table, ParticleStore& store,
+                  unsigned int begin, unsigned int end)
+{
+    if (end < begin + 8)
+        return table.relax(store, begin, end);
+    
+    // x of particle i is at 2*i, y at 2*i+1
+    float* pos = &store.position[0].x;
+    const int* p1 = &table.p1[0];
+    const int* p2 = &table.p2[0];
+    
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+    __m256 max_residual = zero;
+    unsigned int k = begin;
+    for (; k + 8 <= end; k += 8)
+    {
+        __m256 x1, y1, x2, y2;
+        load_positions(pos, p1 + k, x1, y1);
+        load_positions(pos, p2 + k, x2, y2);
+        
+        __m256 dx = _mm256_sub_ps(x2, x1);
+        __m256 dy = _mm256_sub_ps(y2, y1);
+        __m256 len = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy)));
+        
+        __m256 w1 = _mm256_loadu_ps(&table.inv_mass1[k]);
+        __m256 w2 = _mm256_loadu_ps(&table.inv_mass2[k]);
+        __m256 r0 = _mm256_loadu_ps(&table.r0[k]);
+        __m256 stiffness = _mm256_loadu_ps(&table.stiffness[k]);
+        
+        // Skip the bars with both particles fixed or with zero length
+        __m256 denominator = _mm256_mul_ps(len, _mm256_add_ps(w1, w2));
+        __m256 valid = _mm256_cmp_ps(denominator, zero, _CMP_NEQ_OQ);
+        __m256 s = _mm256_div_ps(_mm256_mul_ps(stiffness, _mm256_sub_ps(len, r0)), denominator);
+        s = _mm256_and_ps(s, valid);
+        
+        __m256 residual = _mm256_andnot_ps(sign_bit, _mm256_div_ps(_mm256_sub_ps(len, r0), r0));
+        max_residual = _mm256_max_ps(max_residual, _mm256_and_ps(residual, valid));
+        
+        __m256 s1 = _mm256_mul_ps(w1, s);
+        __m256 s2 = _mm256_mul_ps(w2, s);
+        
+        // The bars don't share particles, so the order of the stores doesn't matter
+        store_positions(pos, p1 + k, _mm256_fmadd_ps(s1, dx, x1), _mm256_fmadd_ps(s1, dy, y1));
+        store_positions(pos, p2 + k, _mm256_fnmadd_ps(s2, dx, x2), _mm256_fnmadd_ps(s2, dy, y2));
+    }
+    
+    // The remaining bars
+    float residuals[8];
+    _mm256_storeu_ps(residuals, max_residual);
+    double result = table.relax(store, k, end);
+    for (int l = 0; l < 8; l++)
+        if (residuals[l] > result)
+            result = residuals[l];
+    return result;
+}
+
+#endif
+
+#else
+
+bool avx2_supported()
+{
+    return false;
+}
+
+double relax_avx2(const ConstraintTable& table, ParticleStore& store,
+                  unsigned int begin, unsigned int end)
+{
+    return table.relax(store, begin, end);
+}
+
+#endif
+
+RelaxKernel fastest_relax_kernel()
+{
+    static RelaxKernel kernel = avx2_supported() ? relax_avx2 : relax_scalar;
+    return kernel;
+}
+
+const char* relax_kernel_name(RelaxKernel kernel)
+{
+    if (kernel == relax_avx2)
+        return "avx2";
+    return "scalar";
+}
@@ -0,0 +1,36 @@
+//
+//  relax_kernels.h
+//  Trusses
+//
+
+#ifndef __Trusses__relax_kernels__
+#define __Trusses__relax_kernels__
+
+class ConstraintTable;
+class ParticleStore;
+
+// Relaxes the constraints [begin, end) of the table once. The constraints
+// must not share particles, i.e. they have to come from one colour batch,
+// because the vectorised kernels update several of them at once.
+// Returns the largest absolute strain found before the correction.
+typedef double (*RelaxKernel)(const ConstraintTable& table, ParticleStore& store,
+                              unsigned int begin, unsigned int end);
+
+// Plain C++, one bar at a time
+double relax_scalar(const ConstraintTable& table, ParticleStore& store,
+                    unsigned int begin, unsigned int end);
+
+// AVX2, four bars at a time (eight in single precision builds).
+// Only call it if avx2_supported().
+double relax_avx2(const ConstraintTable& table, ParticleStore& store,
+                  unsigned int begin, unsigned int end);
+
+// True if the CPU supports AVX2 and FMA
+bool avx2_supported();
+
+// The fastest kernel supported by this CPU
+RelaxKernel fastest_relax_kernel();
+
+const char* relax_kernel_name(RelaxKernel kernel);
+
+#endif /* defined(__Trusses__relax_kernels__) */
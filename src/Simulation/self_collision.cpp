@@ -0,0 +1,257 @@
+//
+//  self_collision.cpp
+//  Trusses
+//
+
+#include "self_collision.h"
+#include <cmath>
+#include "particle.h"
+#include "bar.h"
+#include "islands.h"
+#include "segment.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+SelfCollision self_collision;
+
+SelfCollision::SelfCollision()
+{
+    enabled = false;
+    radius = DEFAULT_JOINT_RADIUS;
+    last_contacts = 0;
+}
+
+bool SelfCollision::connected(int i, int j) const
+{
+    for (unsigned int k = neighbour_start[i]; k < neighbour_start[i+1]; k++)
+        if (neighbours[k] == j)
+            return true;
+    return false;
+}
+
+double SelfCollision::weight(const ParticleStore& store, int i, double v)
+{
+    if (store.fixed[i])
+        return 0.0;
+    if (store.sleeping[i])
+    {
+        // Resting contacts don't wake the island up
+        if (v <= SLEEP_VELOCITY)
+            return 0.0;
+        islands.wake(i);
+        if (store.sleeping[i])
+            return 0.0;
+    }
+    return store.inv_mass[i];
+}
+
+void SelfCollision::solve(ParticleStore& store, double dt)
+{
+    last_contacts = 0;
+    unsigned int n = store.size();
+    if (!enabled || n == 0 || radius <= 0.0)
+        return;
+    
+    // Store indices of the bars and the neighbours of each particle
+    // (the particles at the other ends of its bars_connected)
+    unsigned int n_bars = bars.size();
+    bar_p1.resize(n_bars);
+    bar_p2.resize(n_bars);
+    neighbour_start.assign(n + 1, 0);
+    for (unsigned int k = 0; k < n_bars; k++)
+    {
+        const Bar& b = bars.at(k);
+        bar_p1[k] = particles.index(b.p1_id);
+        bar_p2[k] = particles.index(b.p2_id);
+        neighbour_start[bar_p1[k] + 1]++;
+        neighbour_start[bar_p2[k] + 1]++;
+    }
+    for (unsigned int i = 1; i <= n; i++)
+        neighbour_start[i] += neighbour_start[i-1];
+    neighbours.resize(neighbour_start[n]);
+    std::vector<unsigned int> next(neighbour_start.begin(), neighbour_start.end() - 1);
+    for (unsigned int k = 0; k < n_bars; k++)
+    {
+        neighbours[next[bar_p1[k]]++] = bar_p2[k];
+        neighbours[next[bar_p2[k]]++] = bar_p1[k];
+    }
+    
+    // Cells of two diameters keep both kinds of queries to a few cells
+    grid.cell_size = 4.0 * radius;
+    grid.build(store, true);
+    
+    // Find the contacts in parallel, in blocks of joints and then bars.
+    // Each block has its own list, and the lists are resolved in order
+    // afterwards, so the result doesn't depend on the number of threads.
+    unsigned int joint_blocks = (n + CONTACT_BLOCK - 1) / CONTACT_BLOCK;
+    unsigned int bar_blocks = (n_bars + CONTACT_BLOCK - 1) / CONTACT_BLOCK;
+    block_contacts.resize(joint_blocks + bar_blocks);
+    thread_pool.run_tasks((int)(joint_blocks + bar_blocks), [&](int t)
+    {
+        std::vector<Contact>& found = block_contacts[t];
+        found.clear();
+        if (t < (int)joint_blocks)
+            find_joint_contacts(store, t * CONTACT_BLOCK,
+                                std::min(n, (t + 1) * CONTACT_BLOCK), found);
+        else
+        {
+            unsigned int first = (t - joint_blocks) * CONTACT_BLOCK;
+            find_bar_contacts(store, first, std::min(n_bars, first + CONTACT_BLOCK), found);
+        }
+    });
+    
+    // Earlier corrections can separate the elements of later contacts,
+    // so each one is checked again before it's resolved
+    for (unsigned int t = 0; t < block_contacts.size(); t++)
+    {
+        const std::vector<Contact>& found = block_contacts[t];
+        for (unsigned int c = 0; c < found.size(); c++)
+        {
+            bool resolved = found[c].bar == -1 ?
+                resolve_joints(store, found[c].joint, found[c].other, dt) :
+                resolve_bar(store, found[c].joint, found[c].bar, dt);
+            if (resolved)
+                last_contacts++;
+        }
+    }
+}
+
+void SelfCollision::find_joint_contacts(const ParticleStore& store, unsigned int begin,
+                                        unsigned int end, std::vector<Contact>& found) const
+{
+    // Each pair is found by its lower index, unless that particle can't move
+    double diameter = 2.0 * radius;
+    Vector2d reach(diameter, diameter);
+    std::vector<int> candidates;
+    for (unsigned int i = begin; i < end; i++)
+    {
+        if (store.fixed[i] || store.sleeping[i])
+            continue;
+        
+        candidates.clear();
+        grid.query(store.position[i] - reach, store.position[i] + reach, candidates);
+        for (unsigned int c = 0; c < candidates.size(); c++)
+        {
+            int j = candidates[c];
+            bool j_moves = !store.fixed[j] && !store.sleeping[j];
+            if (j == (int)i || (j_moves && j < (int)i))
+                continue;
+            
+            double dist2 = (store.position[i] - store.position[j]).abs2();
+            if (dist2 >= diameter * diameter || connected(i, j))
+                continue;
+            
+            Contact contact = {(int)i, j, -1};
+            found.push_back(contact);
+        }
+    }
+}
+
+void SelfCollision::find_bar_contacts(const ParticleStore& store, unsigned int begin,
+                                      unsigned int end, std::vector<Contact>& found) const
+{
+    // The joints at the ends of the bar and their neighbours are skipped
+    Vector2d margin(radius, radius);
+    std::vector<int> candidates;
+    for (unsigned int k = begin; k < end; k++)
+    {
+        int a = bar_p1[k];
+        int b = bar_p2[k];
+        const Vector2d& pa = store.position[a];
+        const Vector2d& pb = store.position[b];
+        bool bar_moves = (!store.fixed[a] && !store.sleeping[a]) ||
+                         (!store.fixed[b] && !store.sleeping[b]);
+        
+        Vector2d box_min(pa.x < pb.x ? pa.x : pb.x, pa.y < pb.y ? pa.y : pb.y);
+        Vector2d box_max(pa.x > pb.x ? pa.x : pb.x, pa.y > pb.y ? pa.y : pb.y);
+        candidates.clear();
+        grid.query(box_min - margin, box_max + margin, candidates);
+        
+        for (unsigned int c = 0; c < candidates.size(); c++)
+        {
+            int j = candidates[c];
+            bool j_moves = !store.fixed[j] && !store.sleeping[j];
+            if (j == a || j == b || (!j_moves && !bar_moves))
+                continue;
+            
+            Vector2d d = store.position[j] - Segment(pa, pb).closest_point(store.position[j]);
+            if (d.abs2() >= radius * radius || connected(j, a) || connected(j, b))
+                continue;
+            
+            Contact contact = {j, -1, (int)k};
+            found.push_back(contact);
+        }
+    }
+}
+
+bool SelfCollision::resolve_joints(ParticleStore& store, int i, int j, double dt)
+{
+    double diameter = 2.0 * radius;
+    Vector2d d = store.position[i] - store.position[j];
+    double dist2 = d.abs2();
+    if (dist2 >= diameter * diameter || dist2 == 0.0)
+        return false;
+    
+    double dist = std::sqrt(dist2);
+    double speed = (store.position[i] - store.prev_position[i]).abs() / dt;
+    double wi = store.inv_mass[i];
+    double wj = weight(store, j, speed);
+    Vector2d correction = (diameter - dist) / (dist * (wi + wj)) * d;
+    store.position[i] += wi * correction;
+    store.position[j] -= wj * correction;
+    return true;
+}
+
+bool SelfCollision::resolve_bar(ParticleStore& store, int j, int k, double dt)
+{
+    int a = bar_p1[k];
+    int b = bar_p2[k];
+    
+    // Closest point of the bar
+    Vector2d ab = store.position[b] - store.position[a];
+    double len2 = ab.abs2();
+    if (len2 == 0.0)
+        return false;
+    double t = ((store.position[j] - store.position[a]) * ab) / len2;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+    Vector2d d = store.position[j] - (store.position[a] + t * ab);
+    double dist2 = d.abs2();
+    if (dist2 >= radius * radius || dist2 == 0.0)
+        return false;
+    
+    // Speed of the joint relative to the point of the bar
+    Vector2d step_j = store.position[j] - store.prev_position[j];
+    Vector2d step_bar = (1.0 - t) * (store.position[a] - store.prev_position[a]) +
+                        t * (store.position[b] - store.prev_position[b]);
+    double speed = (step_j - step_bar).abs() / dt;
+    
+    double wj = weight(store, j, speed);
+    double wa = weight(store, a, speed);
+    double wb = weight(store, b, speed);
+    double w = wj + wa * (1.0 - t) * (1.0 - t) + wb * t * t;
+    if (w == 0.0)
+        return false;
+    
+    // A joint which has crossed the bar within the step goes back
+    // to the side it came from, rather than out of the other side
+    double dist = std::sqrt(dist2);
+    double depth = radius - dist;
+    if (t > 0.0 && t < 1.0)
+    {
+        Vector2d prev_ab = store.prev_position[b] - store.prev_position[a];
+        double prev_side = prev_ab.cross(store.prev_position[j] - store.prev_position[a]);
+        if (prev_side * ab.cross(d) < 0.0)
+        {
+            d = -1.0 * d;
+            depth = radius + dist;
+        }
+    }
+    
+    // The joint and the bar move apart along the normal, the ends
+    // of the bar in proportion to how close the contact is to them
+    Vector2d correction = depth / (dist * w) * d;
+    store.position[j] += wj * correction;
+    store.position[a] -= wa * (1.0 - t) * correction;
+    store.position[b] -= wb * t * correction;
+    return true;
+}
@@ -0,0 +1,93 @@
+//
+//  self_collision.h
+//  Trusses
+//
+
+#ifndef __Trusses__self_collision__
+#define __Trusses__self_collision__
+
+#include <vector>
+#include "spatial_hash.h"
+
+class ParticleStore;
+
+// Default radius of a joint (in metres) used by the self-collisions
+#define DEFAULT_JOINT_RADIUS 0.05
+
+// Number of joints or bars checked by one task of the contact search
+#define CONTACT_BLOCK 1024u
+
+// Contacts between the elements of the structures: joints keep at
+// least two radii away from each other and at least one radius away
+// from the bars. Elements which are neighbours through a bar never
+// collide, otherwise every joint would touch the bars it holds.
+//
+// The joints are found through a spatial hash of all the particles, so
+// a step costs about O(particles + bars) as long as the bars aren't much
+// longer than the cells. The search runs on the thread pool, the contacts
+// are then resolved one after another. Joints moving more than a radius
+// per step can still pass through. Fixed and sleeping particles don't
+// move, a sleeping island is woken up when something hits it fast enough.
+class SelfCollision
+{
+public:
+    SelfCollision();
+    
+    // Self-collisions are off by default
+    bool enabled;
+    
+    double radius;
+    
+    // Moves the particles of the store out of contact. Called once per
+    // step after the relaxation and before the collisions with
+    // obstacles, dt is the step (in seconds).
+    void solve(ParticleStore& store, double dt);
+    
+    // Number of contacts found in the last step
+    unsigned int contacts() const {return last_contacts;}
+    
+private:
+    SpatialHash grid;
+    unsigned int last_contacts;
+    
+    // Store index of both particles of each bar
+    std::vector<int> bar_p1;
+    std::vector<int> bar_p2;
+    
+    // Store indices of the particles sharing a bar with particle i are
+    // neighbours[neighbour_start[i]] ... neighbours[neighbour_start[i+1] - 1]
+    std::vector<unsigned int> neighbour_start;
+    std::vector<int> neighbours;
+    
+    // Joint against joint other, or against bar index bar if
+    // it isn't -1
+    struct Contact
+    {
+        int joint;
+        int other;
+        int bar;
+    };
+    std::vector<std::vector<Contact> > block_contacts;
+    
+    // True if a bar connects the particles at store indices i and j
+    bool connected(int i, int j) const;
+    
+    // Inverse mass used in the contacts, zero for particles which
+    // don't move. Wakes up sleeping particles hit at speed v.
+    double weight(const ParticleStore& store, int i, double v);
+    
+    // Append the contacts of the joints or bars in [begin, end)
+    void find_joint_contacts(const ParticleStore& store, unsigned int begin,
+                             unsigned int end, std::vector<Contact>& found) const;
+    void find_bar_contacts(const ParticleStore& store, unsigned int begin,
+                           unsigned int end, std::vector<Contact>& found) const;
+    
+    // Push the elements of a contact apart. Return false if
+    // they aren't in contact any more.
+    bool resolve_joints(ParticleStore& store, int i, int j, double dt);
+    bool resolve_bar(ParticleStore& store, int j, int k, double dt);
+};
+
+extern SelfCollision self_collision;
+
+#endif /* defined(__Trusses__self_collision__) */
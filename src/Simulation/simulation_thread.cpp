@@ -0,0 +1,274 @@
+//
+//  simulation_thread.cpp
+//  Trusses
+//
+
+#include "simulation_thread.h"
+#include <chrono>
+#include "game.h"
+#include "journal.h"
+#include "particle.h"
+#include "particle_store.h"
+#include "bar.h"
+#include "timeline.h"
+
+SimulationThread simulation_thread;
+
+int WorldSnapshot::index(int particle_id) const
+{
+    if (particle_id < 0 || particle_id >= (int)particle_index.size())
+        return -1;
+    return particle_index[particle_id];
+}
+
+void WorldSnapshot::particles_within(const Vector2d& pos, double dist, std::vector<int>& ids) const
+{
+    double dist2 = dist * dist;
+    for (unsigned int i = 0; i < position.size(); i++)
+    {
+        if ((pos - position[i]).abs2() < dist2)
+            ids.push_back(particle_id[i]);
+    }
+}
+
+// * * * * * * * * * * //
+SimulationThread::SimulationThread()
+{
+    is_running = false;
+    has_finished = false;
+    pause_requests = 0;
+    paused = false;
+    stopping = false;
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (is_running)
+        return;
+    
+    stopping = false;
+    paused = false;
+    pause_requests = 0;
+    has_finished = false;
+    
+    // The first snapshot is ready before the thread starts
+    publish();
+    snapshots.update();
+    
+    is_running = true;
+    thread = std::thread(&SimulationThread::loop, this);
+}
+
+void SimulationThread::stop()
+{
+    if (!is_running)
+        return;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+    is_running = false;
+    
+    // The changes posted too late still have to be made
+    std::vector<std::function<void()> > tasks;
+    tasks.swap(posted);
+    for (unsigned int i = 0; i < tasks.size(); i++)
+        tasks[i]();
+}
+
+bool SimulationThread::running() const
+{
+    return is_running;
+}
+
+bool SimulationThread::finished() const
+{
+    return has_finished;
+}
+
+void SimulationThread::post(const std::function<void()>& f)
+{
+    if (!is_running)
+    {
+        f();
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        posted.push_back(f);
+    }
+    cv.notify_all();
+}
+
+void SimulationThread::update_snapshot()
+{
+    snapshots.update();
+}
+
+const WorldSnapshot& SimulationThread::snapshot() const
+{
+    return snapshots.front();
+}
+
+bool SimulationThread::pause()
+{
+    if (!is_running || std::this_thread::get_id() == thread.get_id())
+        return false;
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    pause_requests++;
+    cv.notify_all();
+    cv.wait(lock, [this] {return paused || has_finished;});
+    return true;
+}
+
+void SimulationThread::resume()
+{
+    if (!is_running)
+        return;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pause_requests--;
+    }
+    cv.notify_all();
+}
+
+void SimulationThread::loop()
+{
+    unsigned long long int previous;
+    microsecond_time(previous);
+    while (true)
+    {
+        // Structure changed other than by the steps
+        bool changed = false;
+        
+        std::vector<std::function<void()> > tasks;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pause_requests > 0 && !stopping)
+            {
+                paused = true;
+                cv.notify_all();
+                cv.wait(lock, [this] {return pause_requests == 0 || stopping;});
+                paused = false;
+                changed = true;
+                
+                // The time spent paused isn't caught up with
+                microsecond_time(previous);
+            }
+            if (stopping)
+                break;
+            tasks.swap(posted);
+        }
+        
+        for (unsigned int i = 0; i < tasks.size(); i++)
+            tasks[i]();
+        changed = changed || !tasks.empty();
+        
+        // The interface takes the structure back
+        if (!game.simulation_running() || journal.replaying())
+            break;
+        
+        unsigned long long int now;
+        microsecond_time(now);
+        game.advance(now - previous);
+        previous = now;
+        
+        if (changed || game.steps_last_frame() > 0)
+            publish();
+        
+        // Nothing to simulate yet. Sleep until the next step
+        // is due, unless there is something else to do.
+        if (game.steps_last_frame() == 0)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait_for(lock, std::chrono::microseconds((long long int)(game.dt_us() / 4) + 1), [this]
+            {
+                return !posted.empty() || pause_requests > 0 || stopping;
+            });
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        has_finished = true;
+    }
+    cv.notify_all();
+}
+
+void SimulationThread::publish()
+{
+    TraceSpan span("publish");
+    WorldSnapshot& s = snapshots.back();
+    
+    unsigned int n = particle_store.size();
+    s.position.assign(particle_store.position.begin(), particle_store.position.end());
+    s.fixed.assign(particle_store.fixed.begin(), particle_store.fixed.end());
+    s.particle_id.resize(n);
+    int max_id = -1;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        s.particle_id[i] = particles.at(i).id_;
+        if (s.particle_id[i] > max_id)
+            max_id = s.particle_id[i];
+    }
+    s.particle_index.assign(max_id + 1, -1);
+    for (unsigned int i = 0; i < n; i++)
+        s.particle_index[s.particle_id[i]] = i;
+    
+    s.trace_particle.clear();
+    s.trace_start.clear();
+    s.trace_points.clear();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (!particle_store.traced[i])
+            continue;
+        const FixedSizeContainer<Vector2d>& trace = particles.at(i).trace_points;
+        s.trace_particle.push_back(i);
+        s.trace_start.push_back((int)s.trace_points.size());
+        for (unsigned int k = 0; k < trace.size(); k++)
+            s.trace_points.push_back(trace.get(k));
+    }
+    
+    unsigned int n_bars = bars.size();
+    s.bar_p1.resize(n_bars);
+    s.bar_p2.resize(n_bars);
+    s.bar_id.resize(n_bars);
+    s.bar_strain.resize(n_bars);
+    s.bar_material.resize(n_bars);
+    for (unsigned int i = 0; i < n_bars; i++)
+    {
+        const Bar& b = bars.at(i);
+        s.bar_p1[i] = s.particle_index[b.p1_id];
+        s.bar_p2[i] = s.particle_index[b.p2_id];
+        s.bar_id[i] = b.id_;
+        s.bar_strain[i] = b.get_strain();
+        s.bar_material[i] = b.get_material();
+    }
+    
+    s.simulation_time_s = game.simulation_time_s();
+    s.iterations = game.iterations_last_frame();
+    snapshots.publish();
+}
+
+// * * * * * * * * * * //
+SimulationPause::SimulationPause()
+{
+    paused = simulation_thread.pause();
+}
+
+SimulationPause::~SimulationPause()
+{
+    if (paused)
+        simulation_thread.resume();
+}
@@ -0,0 +1,137 @@
+//
+//  simulation_thread.h
+//  Trusses
+//
+
+#ifndef __Trusses__simulation_thread__
+#define __Trusses__simulation_thread__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "vector2d.h"
+#include "triple_buffer.h"
+
+// What is drawn of the structure, copied after the steps of one loop of
+// the simulation thread. It's never changed once published, so it can be
+// drawn while the next steps are simulated.
+struct WorldSnapshot
+{
+    // Particles in the order of the particle store
+    std::vector<Vector2d> position;
+    std::vector<char> fixed;
+    std::vector<int> particle_id;
+    
+    // Index of each particle id in the arrays above, -1 for unused ids
+    std::vector<int> particle_index;
+    
+    // Paths of the traced particles, stored one after another. Trace i
+    // belongs to the particle at index trace_particle[i] and its points
+    // start at trace_start[i].
+    std::vector<int> trace_particle;
+    std::vector<int> trace_start;
+    std::vector<Vector2d> trace_points;
+    
+    // Bars, with their ends given as indices of the particles
+    std::vector<int> bar_p1;
+    std::vector<int> bar_p2;
+    std::vector<int> bar_id;
+    std::vector<Real> bar_strain;
+    std::vector<unsigned char> bar_material;
+    
+    double simulation_time_s;
+    int iterations;
+    
+    // Index of the particle of this id, -1 if it doesn't exist
+    int index(int particle_id) const;
+    
+    // Appends the ids of the particles closer to pos than dist
+    void particles_within(const Vector2d& pos, double dist, std::vector<int>& ids) const;
+};
+
+// Runs the simulation on its own thread, so that slow steps don't hold up
+// the interface and slow drawing doesn't hold up the simulation. After
+// each loop of steps the thread publishes a snapshot of the structure,
+// which the interface draws instead of the structure itself.
+//
+// While it runs, the thread owns the structure and the simulation
+// settings. Changes from the interface are either posted to it, to be
+// made between two steps, or made while the thread is paused (see
+// SimulationPause). The thread stops by itself when the simulation mode
+// is left or a journal is replayed (replayed commands have to run on
+// the interface thread); stop() then hands the structure back.
+class SimulationThread
+{
+public:
+    SimulationThread();
+    ~SimulationThread();
+    
+    // Starts stepping the simulation in real time on a new thread
+    void start();
+    
+    // Waits for the thread to finish and runs the functions still posted
+    void stop();
+    
+    // True between start() and stop()
+    bool running() const;
+    
+    // True once the thread has stopped stepping by itself
+    bool finished() const;
+    
+    // Runs f on the simulation thread before its next step. Functions
+    // run in the order they were posted. Without the thread, f is run
+    // right away.
+    void post(const std::function<void()>& f);
+    
+    // Takes the latest snapshot, if a new one has been published.
+    // Should be called once per frame before drawing.
+    void update_snapshot();
+    
+    // The snapshot taken by the last update_snapshot()
+    const WorldSnapshot& snapshot() const;
+    
+    // Waits until the thread is between two steps and keeps it there
+    // until resume(). Returns false if the thread isn't running (or
+    // pause() is called from the thread itself), in which case
+    // resume() mustn't be called.
+    bool pause();
+    void resume();
+
+private:
+    void loop();
+    
+    // Copies the structure to the back buffer and publishes it
+    void publish();
+    
+    std::thread thread;
+    bool is_running;
+    std::atomic<bool> has_finished;
+    
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::function<void()> > posted;
+    int pause_requests;
+    bool paused;
+    bool stopping;
+    
+    TripleBuffer<WorldSnapshot> snapshots;
+};
+
+extern SimulationThread simulation_thread;
+
+// Pauses the simulation thread (if it runs) for its lifetime, so that
+// the structure can be changed directly. Pauses can be nested.
+class SimulationPause
+{
+public:
+    SimulationPause();
+    ~SimulationPause();
+
+private:
+    bool paused;
+};
+
+#endif /* defined(__Trusses__simulation_thread__) */
@@ -0,0 +1,136 @@
+//
+//  solver.cpp
+//  Trusses
+//
+
+#include "solver.h"
+#include "constraint_table.h"
+#include "particle_store.h"
+#include "thread_pool.h"
+#include "relax_kernels.h"
+#include <atomic>
+
+// Smallest number of bars given to one thread
+#define MIN_BATCH 256
+
+Solver solver;
+
+Solver::Solver()
+{
+    mode = SERIAL_SOLVER;
+    method = PBD_RELAX;
+    min_iterations = MIN_RELAX_ITER;
+    max_iterations = RELAX_ITER;
+    tolerance = RELAX_TOLERANCE;
+    vectorised = true;
+    iterations = 0;
+    residual = 0.0;
+}
+
+// Lock-free maximum of the residuals found by the threads
+static void atomic_max(std::atomic<double>& target, double value)
+{
+    double current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        ;
+}
+
+std::function<double(unsigned int, unsigned int)>
+Solver::batch_function(ConstraintTable& table, ParticleStore& store, double dt) const
+{
+    if (method == XPBD_RELAX)
+    {
+        double inv_dt2 = 1.0 / (dt * dt);
+        return [&table, &store, inv_dt2](unsigned int begin, unsigned int end)
+        {
+            return table.relax_xpbd(store, begin, end, inv_dt2);
+        };
+    }
+    
+    RelaxKernel kernel = vectorised ? fastest_relax_kernel() : relax_scalar;
+    return [&table, &store, kernel](unsigned int begin, unsigned int end)
+    {
+        return kernel(table, store, begin, end);
+    };
+}
+
+int Solver::relax_serial(const std::function<double(unsigned int, unsigned int)>& batch,
+                         const ConstraintTable& table, unsigned int first_batch,
+                         unsigned int last_batch, double& max_residual) const
+{
+    // The table is sorted by colour, so relaxing the colour batches in
+    // order is the same Gauss-Seidel sweep as going through the whole table
+    int passes = 0;
+    while (passes < max_iterations)
+    {
+        max_residual = 0.0;
+        for (unsigned int c = first_batch; c < last_batch; c++)
+        {
+            double r = batch(table.colour_start[c], table.colour_start[c+1]);
+            if (r > max_residual)
+                max_residual = r;
+        }
+        passes++;
+        
+        if (passes >= min_iterations && max_residual < tolerance)
+            break;
+    }
+    return passes;
+}
+
+void Solver::relax(ConstraintTable& table, ParticleStore& store, double dt)
+{
+    // Relaxes the constraints in [begin, end) and returns their largest residual
+    std::function<double(unsigned int, unsigned int)> batch = batch_function(table, store, dt);
+    if (method == XPBD_RELAX)
+        table.reset_multipliers();
+    iterations = 0;
+    residual = 0.0;
+    
+    if (mode != COLOURED_SOLVER)
+    {
+        iterations = relax_serial(batch, table, 0, table.colours(), residual);
+        return;
+    }
+    
+    // Relax the colours one after another, and the bars
+    // within each colour in parallel
+    std::atomic<double> pass_residual(0.0);
+    std::function<void(int, int)> task = [&batch, &pass_residual](int begin, int end)
+    {
+        atomic_max(pass_residual, batch(begin, end));
+    };
+    while (iterations < max_iterations)
+    {
+        pass_residual.store(0.0);
+        for (unsigned int c = 0; c < table.colours(); c++)
+            thread_pool.parallel_for(table.colour_start[c], table.colour_start[c+1], MIN_BATCH, task);
+        residual = pass_residual.load();
+        iterations++;
+        
+        if (iterations >= min_iterations && residual < tolerance)
+            break;
+    }
+}
+
+int Solver::relax_island(ConstraintTable& table, ParticleStore& store, double dt,
+                         unsigned int island, double& max_residual) const
+{
+    unsigned int first_batch = table.island_batch[island];
+    unsigned int last_batch = table.island_batch[island + 1];
+    if (method == XPBD_RELAX)
+        table.reset_multipliers(table.colour_start[first_batch], table.colour_start[last_batch]);
+    
+    max_residual = 0.0;
+    return relax_serial(batch_function(table, store, dt), table, first_batch, last_batch, max_residual);
+}
+
+int Solver::last_iterations() const
+{
+    return iterations;
+}
+
+double Solver::last_residual() const
+{
+    return residual;
+}
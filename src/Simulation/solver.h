@@ -0,0 +1,87 @@
+//
+//  solver.h
+//  Trusses
+//
+
+#ifndef __Trusses__solver__
+#define __Trusses__solver__
+
+#include <functional>
+
+#define RELAX_ITER 30
+
+// Default bounds of the adaptive relaxation
+#define MIN_RELAX_ITER 4
+#define RELAX_TOLERANCE 1e-5
+
+class ConstraintTable;
+class ParticleStore;
+
+// SERIAL_SOLVER: Gauss-Seidel sweep over all the bars on one thread.
+// COLOURED_SOLVER: bars of one colour don't share particles, so each
+// colour is relaxed in parallel on the thread pool.
+// ISLAND_SOLVER: islands (see Islands) don't share bars, so each one is
+// stepped on its own thread by Game, from integration to fracture.
+enum SolverMode {SERIAL_SOLVER, COLOURED_SOLVER, ISLAND_SOLVER};
+
+// PBD_RELAX: each pass moves the particles by a fraction (the bar
+// stiffness) of the error, so rigidity grows with the number of passes.
+// XPBD_RELAX: bars have a physical compliance and a Lagrange multiplier
+// per step, so rigidity doesn't depend on the passes or the time step.
+enum RelaxMethod {PBD_RELAX, XPBD_RELAX};
+
+// Satisfies the constraints imposed by bars by relaxation
+class Solver
+{
+    friend class Game;
+public:
+    Solver();
+    
+    SolverMode mode;
+    RelaxMethod method;
+    
+    // Relaxation stops after min_iterations once the largest strain
+    // residual of a pass falls below the tolerance, and after
+    // max_iterations in any case. Large number of iterations means
+    // accurate simulation, and hence stiff bars. Zero tolerance
+    // always runs max_iterations.
+    int min_iterations;
+    int max_iterations;
+    double tolerance;
+    
+    // Use the vectorised kernel if the CPU supports it. XPBD
+    // always uses the scalar kernel.
+    bool vectorised;
+    
+    // Relaxes the constraints of one simulation step of length dt (in seconds)
+    void relax(ConstraintTable& table, ParticleStore& store, double dt);
+    
+    // Relaxes the bars of one island on the calling thread. The table has
+    // to be in the island order. Returns the number of passes. Doesn't
+    // change the statistics below, so islands can be relaxed in parallel.
+    int relax_island(ConstraintTable& table, ParticleStore& store, double dt,
+                     unsigned int island, double& max_residual) const;
+    
+    // Number of passes and the largest residual of the last relax()
+    int last_iterations() const;
+    double last_residual() const;
+    
+private:
+    int iterations;
+    double residual;
+    
+    // Returns a function relaxing the constraints in [begin, end)
+    // once and returning their largest residual
+    std::function<double(unsigned int, unsigned int)>
+    batch_function(ConstraintTable& table, ParticleStore& store, double dt) const;
+    
+    // Relaxes the colour batches [first_batch, last_batch) in order until
+    // they converge, returns the number of passes
+    int relax_serial(const std::function<double(unsigned int, unsigned int)>& batch,
+                     const ConstraintTable& table, unsigned int first_batch,
+                     unsigned int last_batch, double& max_residual) const;
+};
+
+extern Solver solver;
+
+#endif /* defined(__Trusses__solver__) */
@@ -0,0 +1,69 @@
+//
+//  sparse_matrix.cpp
+//  Trusses
+//
+
+#include "sparse_matrix.h"
+#include "thread_pool.h"
+
+// Smallest number of rows or elements given to one thread
+#define MIN_ROWS 1024
+
+// Length of the blocks summed separately by parallel_dot
+#define DOT_BLOCK 4096
+
+double SparseMatrix::at(int r, int c) const
+{
+    for (int k = row_start[r]; k < row_start[r+1]; k++)
+        if (column[k] == c)
+            return value[k];
+    return 0.0;
+}
+
+void SparseMatrix::multiply(const std::vector<double>& x, std::vector<double>& y) const
+{
+    y.resize(rows());
+    const SparseMatrix& m = *this;
+    thread_pool.parallel_for(0, rows(), MIN_ROWS, [&m, &x, &y](int begin, int end)
+    {
+        for (int r = begin; r < end; r++)
+        {
+            double sum = 0.0;
+            for (int k = m.row_start[r]; k < m.row_start[r+1]; k++)
+                sum += m.value[k] * x[m.column[k]];
+            y[r] = sum;
+        }
+    });
+}
+
+double parallel_dot(const std::vector<double>& a, const std::vector<double>& b)
+{
+    int n = (int)a.size();
+    int n_blocks = (n + DOT_BLOCK - 1) / DOT_BLOCK;
+    std::vector<double> partial(n_blocks, 0.0);
+    thread_pool.parallel_for(0, n_blocks, 1, [&a, &b, &partial, n](int begin, int end)
+    {
+        for (int block = begin; block < end; block++)
+        {
+            int last = (block + 1) * DOT_BLOCK < n ? (block + 1) * DOT_BLOCK : n;
+            double sum = 0.0;
+            for (int i = block * DOT_BLOCK; i < last; i++)
+                sum += a[i] * b[i];
+            partial[block] = sum;
+        }
+    });
+    
+    double sum = 0.0;
+    for (int block = 0; block < n_blocks; block++)
+        sum += partial[block];
+    return sum;
+}
+
+void parallel_axpy(double a, const std::vector<double>& x, std::vector<double>& y)
+{
+    thread_pool.parallel_for(0, (int)x.size(), MIN_ROWS, [a, &x, &y](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+            y[i] += a * x[i];
+    });
+}
@@ -0,0 +1,37 @@
+//
+//  sparse_matrix.h
+//  Trusses
+//
+
+#ifndef __Trusses__sparse_matrix__
+#define __Trusses__sparse_matrix__
+
+#include <vector>
+
+// Square matrix in compressed sparse row form. The entries of row r
+// are in [row_start[r], row_start[r+1]), in no particular order.
+class SparseMatrix
+{
+public:
+    std::vector<int> row_start;
+    std::vector<int> column;
+    std::vector<double> value;
+    
+    unsigned int rows() const {return row_start.empty() ? 0 : (unsigned int)row_start.size() - 1;}
+    
+    // Value at (r, c), zero if it isn't stored
+    double at(int r, int c) const;
+    
+    // y = A x. Rows are split between the threads of thread_pool.
+    void multiply(const std::vector<double>& x, std::vector<double>& y) const;
+};
+
+// Vector operations used by iterative solvers, split between the
+// threads of thread_pool. The dot product adds the partial sums in a
+// fixed order, so the result doesn't depend on the number of threads.
+double parallel_dot(const std::vector<double>& a, const std::vector<double>& b);
+
+// y += a x
+void parallel_axpy(double a, const std::vector<double>& x, std::vector<double>& y);
+
+#endif /* defined(__Trusses__sparse_matrix__) */
@@ -0,0 +1,134 @@
+//
+//  spatial_hash.cpp
+//  Trusses
+//
+
+#include "spatial_hash.h"
+#include <cmath>
+#include "particle_store.h"
+
+SpatialHash particle_grid;
+
+// Cells further from the origin are merged, so that the cast to int is
+// defined even for the positions of a simulation which has blown up.
+// NaN ends up in the lowest cell.
+#define MAX_CELL 1e9
+
+static int cell_index(double x, double cell)
+{
+    double c = std::floor(x / cell);
+    if (!(c > -MAX_CELL))
+        return (int)-MAX_CELL;
+    if (c > MAX_CELL)
+        return (int)MAX_CELL;
+    return (int)c;
+}
+
+SpatialHash::SpatialHash()
+{
+    cell_size = DEFAULT_CELL_SIZE;
+    cell = cell_size;
+    indexed = NULL;
+    max_step = 0.0;
+    bucket_start.assign(2, 0);
+}
+
+unsigned int SpatialHash::bucket(int ix, int iy) const
+{
+    // The number of buckets is a power of two
+    unsigned int h = (unsigned int)ix * 73856093u ^ (unsigned int)iy * 19349663u;
+    return h & (unsigned int)(bucket_start.size() - 2);
+}
+
+void SpatialHash::build(const ParticleStore& store, bool all_particles)
+{
+    indexed = &store;
+    cell = cell_size;
+    unsigned int n = store.size();
+    
+    // About two buckets per particle
+    unsigned int n_buckets = 1;
+    while (n_buckets < 2 * n)
+        n_buckets *= 2;
+    bucket_start.assign(n_buckets + 1, 0);
+    particle_bucket.resize(n);
+    cell_x.resize(n);
+    cell_y.resize(n);
+    
+    // Count the particles in each bucket
+    double max_step2 = 0.0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        bool moving = !store.fixed[i] && !store.sleeping[i];
+        if (!moving && !all_particles)
+        {
+            particle_bucket[i] = n_buckets;
+            continue;
+        }
+        const Vector2d& p = store.position[i];
+        cell_x[i] = cell_index(p.x, cell);
+        cell_y[i] = cell_index(p.y, cell);
+        particle_bucket[i] = bucket(cell_x[i], cell_y[i]);
+        bucket_start[particle_bucket[i] + 1]++;
+        if (!moving)
+            continue;
+        
+        double step2 = (p - store.prev_position[i]).abs2();
+        if (step2 > max_step2)
+            max_step2 = step2;
+    }
+    max_step = std::sqrt(max_step2);
+    for (unsigned int b = 1; b <= n_buckets; b++)
+        bucket_start[b] += bucket_start[b-1];
+    
+    // Place the particles
+    std::vector<unsigned int> position(bucket_start.begin(), bucket_start.end() - 1);
+    entries.resize(bucket_start.back());
+    for (unsigned int i = 0; i < n; i++)
+        if (particle_bucket[i] < n_buckets)
+            entries[position[particle_bucket[i]]++] = i;
+}
+
+void SpatialHash::query(const Vector2d& box_min, const Vector2d& box_max,
+                        std::vector<int>& result) const
+{
+    if (!indexed || entries.empty())
+        return;
+    const ParticleStore& store = *indexed;
+    
+    int x0 = cell_index(box_min.x, cell);
+    int y0 = cell_index(box_min.y, cell);
+    int x1 = cell_index(box_max.x, cell);
+    int y1 = cell_index(box_max.y, cell);
+    
+    // A box covering more cells than there are particles is
+    // cheaper to check particle by particle
+    if ((double)(x1 - x0 + 1) * (double)(y1 - y0 + 1) > entries.size())
+    {
+        for (unsigned int j = 0; j < entries.size(); j++)
+        {
+            const Vector2d& p = store.position[entries[j]];
+            if (p.x >= box_min.x && p.x <= box_max.x && p.y >= box_min.y && p.y <= box_max.y)
+                result.push_back(entries[j]);
+        }
+        return;
+    }
+    
+    for (int ix = x0; ix <= x1; ix++)
+    {
+        for (int iy = y0; iy <= y1; iy++)
+        {
+            unsigned int b = bucket(ix, iy);
+            for (unsigned int j = bucket_start[b]; j < bucket_start[b+1]; j++)
+            {
+                // Other cells can share the bucket
+                int i = entries[j];
+                if (cell_x[i] != ix || cell_y[i] != iy)
+                    continue;
+                const Vector2d& p = store.position[i];
+                if (p.x >= box_min.x && p.x <= box_max.x && p.y >= box_min.y && p.y <= box_max.y)
+                    result.push_back(entries[j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+//
+//  spatial_hash.h
+//  Trusses
+//
+
+#ifndef __Trusses__spatial_hash__
+#define __Trusses__spatial_hash__
+
+#include <vector>
+#include "vector2d.h"
+
+class ParticleStore;
+
+// Default side of a cell (in metres)
+#define DEFAULT_CELL_SIZE 0.5
+
+// Uniform grid of the particle positions, with the cells hashed into a
+// table proportional to the number of particles, so that the grid can
+// be unbounded. Rebuilt every step by counting sort, so there is no
+// allocation once the table has grown. Used as the broadphase of the
+// collisions.
+class SpatialHash
+{
+public:
+    SpatialHash();
+    
+    // Side of a cell, used from the next build
+    double cell_size;
+    
+    // Indexes the free, awake particles of the store, or all of
+    // them if all_particles is true
+    void build(const ParticleStore& store, bool all_particles = false);
+    
+    // Appends the indices of the particles which were inside the
+    // cells overlapping the box at the time of the build and are
+    // inside the box now
+    void query(const Vector2d& box_min, const Vector2d& box_max,
+               std::vector<int>& result) const;
+    
+    unsigned int size() const {return (unsigned int)entries.size();}
+    
+    // Longest distance travelled by a free, awake particle in the last step
+    double max_displacement() const {return max_step;}
+    
+private:
+    const ParticleStore* indexed;
+    double cell;
+    double max_step;
+    
+    // Bucket b holds entries [bucket_start[b], bucket_start[b+1])
+    std::vector<unsigned int> bucket_start;
+    std::vector<int> entries;
+    
+    // Bucket and cell of each particle at the time of the build
+    std::vector<unsigned int> particle_bucket;
+    std::vector<int> cell_x;
+    std::vector<int> cell_y;
+    
+    unsigned int bucket(int ix, int iy) const;
+};
+
+extern SpatialHash particle_grid;
+
+#endif /* defined(__Trusses__spatial_hash__) */
@@ -0,0 +1,275 @@
+//
+//  static_solver.cpp
+//  Trusses
+//
+
+#include "static_solver.h"
+#include <cmath>
+#include "particle.h"
+#include "bar.h"
+#include "thread_pool.h"
+
+// Smallest number of unknowns given to one thread
+#define MIN_ROWS 1024
+
+StaticSolver static_solver;
+
+StaticSolver::StaticSolver()
+{
+    tolerance = STATIC_TOLERANCE;
+    max_iterations = 0;
+    n_iterations = 0;
+    last_residual = 0.0;
+}
+
+int StaticSolver::solve()
+{
+    assemble();
+    int result = conjugate_gradient();
+    update_bars();
+    return result;
+}
+
+int StaticSolver::iterations() const
+{
+    return n_iterations;
+}
+
+double StaticSolver::residual() const
+{
+    return last_residual;
+}
+
+unsigned int StaticSolver::unknowns() const
+{
+    return stiffness.rows();
+}
+
+Vector2d StaticSolver::displacement(int particle_id) const
+{
+    int i = particles.index(particle_id);
+    if (i < 0 || i >= dof.size() || dof[i] < 0 || u.size() != stiffness.rows())
+        return Vector2d(0.0, 0.0);
+    return Vector2d(u[dof[i]], u[dof[i] + 1]);
+}
+
+void StaticSolver::assemble()
+{
+    const ParticleStore& store = particle_store;
+    unsigned int n = store.size();
+    
+    // Free particles without bars would make the matrix singular,
+    // so only the ones connected to something are unknowns
+    std::vector<int> neighbours(n, 0);
+    std::vector<char> connected(n, false);
+    for (int k = 0; k < bars.size(); k++)
+    {
+        const Bar& b = bars.at(k);
+        int i1 = particles.index(b.p1_id);
+        int i2 = particles.index(b.p2_id);
+        connected[i1] = connected[i2] = true;
+        if (!store.fixed[i1] && !store.fixed[i2])
+        {
+            neighbours[i1]++;
+            neighbours[i2]++;
+        }
+    }
+    
+    // Each particle has two rows. A row holds the 2x2 diagonal block
+    // followed by the 2x2 blocks of the free neighbours.
+    dof.assign(n, -1);
+    stiffness.row_start.assign(1, 0);
+    std::vector<int> next_block(n, 0);
+    int n_dof = 0;
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (store.fixed[i] || !connected[i])
+            continue;
+        dof[i] = n_dof;
+        n_dof += 2;
+        next_block[i] = stiffness.row_start.back() + 2;
+        for (int row = 0; row < 2; row++)
+            stiffness.row_start.push_back(stiffness.row_start.back() + 2 * (neighbours[i] + 1));
+    }
+    int nnz = stiffness.row_start.back();
+    stiffness.column.assign(nnz, 0);
+    stiffness.value.assign(nnz, 0.0);
+    load.assign(n_dof, 0.0);
+    
+    // Columns of the diagonal blocks
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (dof[i] < 0)
+            continue;
+        for (int row = 0; row < 2; row++)
+        {
+            int start = stiffness.row_start[dof[i] + row];
+            stiffness.column[start] = dof[i];
+            stiffness.column[start + 1] = dof[i] + 1;
+        }
+    }
+    
+    // External loads
+    Vector2d gravity = Particle::gravity();
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (dof[i] < 0)
+            continue;
+        Vector2d f = (1.0 / store.inv_mass[i]) * (gravity + store.acceleration[i]);
+        load[dof[i]] += f.x;
+        load[dof[i] + 1] += f.y;
+    }
+    
+    // Contributions of the bars
+    for (int k = 0; k < bars.size(); k++)
+    {
+        const Bar& b = bars.at(k);
+        int i1 = particles.index(b.p1_id);
+        int i2 = particles.index(b.p2_id);
+        Vector2d d = store.position[i2] - store.position[i1];
+        double len = d.abs();
+        if (len == 0.0)
+            continue;
+        Vector2d e = d / len;
+        double compliance = b.get_compliance();
+        double kb = 1.0 / (compliance > MIN_COMPLIANCE ? compliance : MIN_COMPLIANCE);
+        
+        // k e e^T
+        double block[2][2] = {{kb * e.x * e.x, kb * e.x * e.y},
+                              {kb * e.y * e.x, kb * e.y * e.y}};
+        
+        // The bar is already under tension if its length isn't r0
+        double tension = kb * (len - b.r0);
+        
+        int ends[2] = {i1, i2};
+        for (int end = 0; end < 2; end++)
+        {
+            int i = ends[end];
+            int j = ends[1 - end];
+            if (dof[i] < 0)
+                continue;
+            
+            double sign = end == 0 ? 1.0 : -1.0;
+            load[dof[i]] += sign * tension * e.x;
+            load[dof[i] + 1] += sign * tension * e.y;
+            
+            int off_diagonal = -1;
+            if (dof[j] >= 0)
+            {
+                off_diagonal = next_block[i];
+                next_block[i] += 2;
+            }
+            for (int row = 0; row < 2; row++)
+            {
+                int start = stiffness.row_start[dof[i] + row];
+                stiffness.value[start] += block[row][0];
+                stiffness.value[start + 1] += block[row][1];
+                if (off_diagonal < 0)
+                    continue;
+                
+                // The off-diagonal blocks are at the same
+                // offset in both rows of the particle
+                int pos = start + off_diagonal - stiffness.row_start[dof[i]];
+                stiffness.column[pos] = dof[j];
+                stiffness.column[pos + 1] = dof[j] + 1;
+                stiffness.value[pos] = -block[row][0];
+                stiffness.value[pos + 1] = -block[row][1];
+            }
+        }
+    }
+}
+
+int StaticSolver::conjugate_gradient()
+{
+    unsigned int n = stiffness.rows();
+    u.assign(n, 0.0);
+    n_iterations = 0;
+    last_residual = 0.0;
+    
+    double load_norm = std::sqrt(parallel_dot(load, load));
+    if (n == 0 || load_norm == 0.0)
+        return 0;
+    
+    // Jacobi preconditioner
+    std::vector<double> inv_diagonal(n);
+    for (unsigned int r = 0; r < n; r++)
+    {
+        double diagonal = stiffness.at(r, r);
+        inv_diagonal[r] = diagonal > 0.0 ? 1.0 / diagonal : 1.0;
+    }
+    
+    std::vector<double> r = load;
+    std::vector<double> z(n), p(n), q(n);
+    for (unsigned int i = 0; i < n; i++)
+        z[i] = inv_diagonal[i] * r[i];
+    p = z;
+    double rz = parallel_dot(r, z);
+    
+    int max_iter = max_iterations > 0 ? max_iterations : 2 * n;
+    last_residual = 1.0;
+    while (n_iterations < max_iter)
+    {
+        stiffness.multiply(p, q);
+        double pq = parallel_dot(p, q);
+        
+        // The matrix isn't positive definite, the structure can move freely
+        if (pq <= 0.0)
+            return 1;
+        
+        double alpha = rz / pq;
+        parallel_axpy(alpha, p, u);
+        parallel_axpy(-alpha, q, r);
+        n_iterations++;
+        
+        last_residual = std::sqrt(parallel_dot(r, r)) / load_norm;
+        if (last_residual < tolerance)
+            return 0;
+        
+        std::vector<double>& z_ref = z;
+        const std::vector<double>& r_ref = r;
+        thread_pool.parallel_for(0, n, MIN_ROWS, [&z_ref, &r_ref, &inv_diagonal](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+                z_ref[i] = inv_diagonal[i] * r_ref[i];
+        });
+        double rz_new = parallel_dot(r, z);
+        double beta = rz_new / rz;
+        rz = rz_new;
+        
+        std::vector<double>& p_ref = p;
+        thread_pool.parallel_for(0, n, MIN_ROWS, [&p_ref, &z_ref, beta](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
+                p_ref[i] = z_ref[i] + beta * p_ref[i];
+        });
+    }
+    return 1;
+}
+
+void StaticSolver::update_bars()
+{
+    const ParticleStore& store = particle_store;
+    for (int k = 0; k < bars.size(); k++)
+    {
+        Bar& b = bars.at(k);
+        int i1 = particles.index(b.p1_id);
+        int i2 = particles.index(b.p2_id);
+        Vector2d d = store.position[i2] - store.position[i1];
+        double len = d.abs();
+        if (len == 0.0)
+        {
+            b.static_force = b.static_strain = 0.0;
+            continue;
+        }
+        
+        // Extension of the bar to first order in the displacements
+        Vector2d e = d / len;
+        Vector2d du = displacement(b.p2_id) - displacement(b.p1_id);
+        double extension = len + e * du - b.r0;
+        double compliance = b.get_compliance();
+        double kb = 1.0 / (compliance > MIN_COMPLIANCE ? compliance : MIN_COMPLIANCE);
+        
+        b.static_strain = extension / b.r0;
+        b.static_force = kb * extension;
+    }
+}
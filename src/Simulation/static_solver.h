@@ -0,0 +1,79 @@
+//
+//  static_solver.h
+//  Trusses
+//
+
+#ifndef __Trusses__static_solver__
+#define __Trusses__static_solver__
+
+#include <vector>
+#include "vector2d.h"
+#include "sparse_matrix.h"
+
+// Bars with smaller compliance are treated as having this one,
+// so that rigid bars don't make the stiffness matrix singular
+#define MIN_COMPLIANCE 1e-12
+
+// Default relative residual at which the conjugate gradient stops
+#define STATIC_TOLERANCE 1e-10
+
+// Finds the equilibrium of the structure without running the dynamic
+// simulation. The stiffness matrix of the bars (linearised about the
+// current positions, with the bar stiffness being the inverse of its
+// compliance) is assembled in sparse form and solved for the
+// displacements of the free particles by the conjugate gradient method
+// with a Jacobi preconditioner. Fixed particles are the boundary
+// conditions. Loads are gravity and the external accelerations.
+//
+// The resulting forces and strains are stored in the bars (see
+// Bar::get_static_force). Particles and bars aren't moved.
+class StaticSolver
+{
+public:
+    StaticSolver();
+    
+    // Relative residual |f - Ku| / |f| at which the solution is accepted
+    double tolerance;
+    
+    // Zero means twice the number of unknowns
+    int max_iterations;
+    
+    // Returns 0 if the solution converged, 1 otherwise (e.g. if the
+    // structure is a mechanism and has no unique equilibrium).
+    int solve();
+    
+    // Conjugate gradient iterations and relative residual of the last solve
+    int iterations() const;
+    double residual() const;
+    
+    // Number of unknown displacements in the last solve
+    unsigned int unknowns() const;
+    
+    // Displacement of the particle from its current position to
+    // the equilibrium found by the last solve
+    Vector2d displacement(int particle_id) const;
+    
+private:
+    SparseMatrix stiffness;
+    std::vector<double> load;
+    std::vector<double> u;
+    
+    // Index of the first unknown of each particle in the
+    // particle store, -1 if the particle doesn't move
+    std::vector<int> dof;
+    
+    int n_iterations;
+    double last_residual;
+    
+    void assemble();
+    
+    // Preconditioned conjugate gradient, returns 0 if converged
+    int conjugate_gradient();
+    
+    // Stores the forces and strains in the bars
+    void update_bars();
+};
+
+extern StaticSolver static_solver;
+
+#endif /* defined(__Trusses__static_solver__) */
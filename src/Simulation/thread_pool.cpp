@@ -0,0 +1,226 @@
+//
+//  thread_pool.cpp
+//  Trusses
+//
+
+#include "thread_pool.h"
+#include "timeline.h"
+
+ThreadPool thread_pool;
+
+ThreadPool::ThreadPool()
+{
+    n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0)
+        n_threads = 1;
+    
+    task = NULL;
+    queued_task = NULL;
+    loop_end = 0;
+    chunk = 1;
+    next = 0;
+    busy_workers = 0;
+    generation = 0;
+    stopping = false;
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop_workers();
+}
+
+void ThreadPool::set_threads(unsigned int n)
+{
+    if (n == 0)
+        n = 1;
+    if (n == n_threads)
+        return;
+    
+    stop_workers();
+    n_threads = n;
+}
+
+unsigned int ThreadPool::threads() const
+{
+    return n_threads;
+}
+
+void ThreadPool::start_workers()
+{
+    stopping = false;
+    queues = std::vector<TaskQueue>(n_threads);
+    for (unsigned int i = 1; i < n_threads; i++)
+        workers.push_back(std::thread(&ThreadPool::worker_loop, this, i, generation));
+}
+
+void ThreadPool::stop_workers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+}
+
+void ThreadPool::parallel_for(int begin, int end, int min_chunk,
+                              const std::function<void(int, int)>& f)
+{
+    if (end <= begin)
+        return;
+    if (min_chunk < 1)
+        min_chunk = 1;
+    
+    // Not worth waking up the workers
+    int length = end - begin;
+    if (n_threads == 1 || length < 2 * min_chunk)
+    {
+        f(begin, end);
+        return;
+    }
+    
+    if (workers.empty())
+        start_workers();
+    
+    // Aim for a few chunks per thread to even out the load
+    int n_chunks = 4 * n_threads;
+    chunk = (length + n_chunks - 1) / n_chunks;
+    if (chunk < min_chunk)
+        chunk = min_chunk;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &f;
+        next = begin;
+        loop_end = end;
+        busy_workers = (unsigned int)workers.size();
+        generation++;
+    }
+    start_cv.notify_all();
+    
+    run_chunks();
+    
+    // Wait for the workers to finish their chunks
+    std::unique_lock<std::mutex> lock(mutex);
+    while (busy_workers > 0)
+        done_cv.wait(lock);
+    task = NULL;
+}
+
+void ThreadPool::run_chunks()
+{
+    while (true)
+    {
+        int chunk_begin = next.fetch_add(chunk);
+        if (chunk_begin >= loop_end)
+            return;
+        int chunk_end = chunk_begin + chunk;
+        if (chunk_end > loop_end)
+            chunk_end = loop_end;
+        TraceSpan span("chunk");
+        (*task)(chunk_begin, chunk_end);
+    }
+}
+
+void ThreadPool::run_tasks(int n_tasks, const std::function<void(int)>& f)
+{
+    // Not worth waking up the workers
+    if (n_threads == 1 || n_tasks < 2)
+    {
+        for (int i = 0; i < n_tasks; i++)
+            f(i);
+        return;
+    }
+    
+    if (workers.empty())
+        start_workers();
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < n_tasks; i++)
+            queues[i % n_threads].tasks.push_back(i);
+        queued_task = &f;
+        busy_workers = (unsigned int)workers.size();
+        generation++;
+    }
+    start_cv.notify_all();
+    
+    run_queued_tasks(0);
+    
+    // Wait for the workers to finish their tasks
+    std::unique_lock<std::mutex> lock(mutex);
+    while (busy_workers > 0)
+        done_cv.wait(lock);
+    queued_task = NULL;
+}
+
+bool ThreadPool::pop_task(unsigned int queue, bool own, int& task_index)
+{
+    TaskQueue& q = queues[queue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+        return false;
+    if (own)
+    {
+        task_index = q.tasks.front();
+        q.tasks.pop_front();
+    }
+    else
+    {
+        task_index = q.tasks.back();
+        q.tasks.pop_back();
+    }
+    return true;
+}
+
+void ThreadPool::run_queued_tasks(unsigned int index)
+{
+    int task_index;
+    while (true)
+    {
+        if (pop_task(index, true, task_index))
+        {
+            TraceSpan span("task");
+            (*queued_task)(task_index);
+            continue;
+        }
+        
+        // Steal from the other threads
+        bool stolen = false;
+        for (unsigned int i = 1; i < n_threads && !stolen; i++)
+            stolen = pop_task((index + i) % n_threads, false, task_index);
+        if (!stolen)
+            return;
+        TraceSpan span("stolen task");
+        (*queued_task)(task_index);
+    }
+}
+
+void ThreadPool::worker_loop(unsigned int index, unsigned long long int seen_generation)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping && generation == seen_generation)
+                start_cv.wait(lock);
+            if (stopping)
+                return;
+            seen_generation = generation;
+        }
+        
+        if (queued_task)
+            run_queued_tasks(index);
+        else
+            run_chunks();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy_workers--;
+        }
+        done_cv.notify_one();
+    }
+}
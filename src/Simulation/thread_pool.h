@@ -0,0 +1,93 @@
+//
+//  thread_pool.h
+//  Trusses
+//
+
+#ifndef __Trusses__thread_pool__
+#define __Trusses__thread_pool__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+
+// A fixed set of worker threads which split loops between them.
+// The calling thread takes part in the work as well. Loops of similar
+// iterations are split into chunks taken in order, independent tasks
+// of uneven sizes are dealt to the threads, which steal the tasks of
+// the others once theirs are done.
+class ThreadPool
+{
+public:
+    ThreadPool();
+    ~ThreadPool();
+    
+    // Total number of threads working on a loop, including the
+    // calling thread. Workers are started when they are first needed.
+    void set_threads(unsigned int n);
+    unsigned int threads() const;
+    
+    // Calls task(chunk_begin, chunk_end) for chunks of [begin, end)
+    // in parallel and returns when all of them are done. Chunks are
+    // at least min_chunk long. Must not be called from inside a task.
+    void parallel_for(int begin, int end, int min_chunk,
+                      const std::function<void(int, int)>& task);
+    
+    // Calls task(i) for i in [0, n_tasks) in parallel and returns when
+    // all of them are done. Tasks are dealt to the threads in turn, so
+    // they are best given largest first. Must not be called from inside
+    // a task.
+    void run_tasks(int n_tasks, const std::function<void(int)>& task);
+    
+private:
+    // Tasks dealt to one thread, taken from the front by their
+    // owner and stolen from the back by the others
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+    
+    void start_workers();
+    void stop_workers();
+    void worker_loop(unsigned int index, unsigned long long int seen_generation);
+    
+    // Runs the chunks of the current loop until there are none left
+    void run_chunks();
+    
+    // Runs the tasks of queue index, then the tasks stolen
+    // from the other queues until all of them are empty
+    void run_queued_tasks(unsigned int index);
+    bool pop_task(unsigned int queue, bool own, int& task_index);
+    
+    unsigned int n_threads;
+    std::vector<std::thread> workers;
+    
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    
+    // The current loop
+    const std::function<void(int, int)>* task;
+    int loop_end;
+    int chunk;
+    std::atomic<int> next;
+    
+    // The current set of tasks, one queue per thread
+    const std::function<void(int)>* queued_task;
+    std::vector<TaskQueue> queues;
+    
+    // Workers which haven't finished the current loop yet
+    unsigned int busy_workers;
+    
+    // Incremented for every loop, so that workers know there is new work
+    unsigned long long int generation;
+    bool stopping;
+};
+
+extern ThreadPool thread_pool;
+
+#endif /* defined(__Trusses__thread_pool__) */
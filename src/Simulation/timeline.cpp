@@ -0,0 +1,112 @@
+//
+//  timeline.cpp
+//  Trusses
+//
+
+#include "timeline.h"
+#include <fstream>
+#include "profiler.h"
+
+Timeline timeline;
+
+// Small number identifying the calling thread in the trace
+static int thread_number()
+{
+    static std::atomic<int> threads(0);
+    thread_local int number = threads.fetch_add(1);
+    return number;
+}
+
+Timeline::Timeline() : spans(TIMELINE_SPANS)
+{
+    enabled = false;
+    clear();
+}
+
+void Timeline::record(const char* name, unsigned long long int start_ns,
+                      unsigned long long int duration_ns)
+{
+    unsigned long long int index = next.fetch_add(1, std::memory_order_relaxed);
+    Span& span = spans[index & (TIMELINE_SPANS - 1)];
+    
+    span.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    span.name = name;
+    span.start = start_ns;
+    span.duration = duration_ns;
+    span.thread = thread_number();
+    span.sequence.store(index + 1, std::memory_order_release);
+}
+
+int Timeline::dump(const std::string& filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+        return 1;
+    
+    // Copy the finished spans first, so that the times
+    // can be given relative to the earliest one
+    std::vector<Span> copies(size());
+    unsigned int n = 0;
+    unsigned long long int first_start = 0;
+    for (unsigned int i = 0; i < spans.size(); i++)
+    {
+        const Span& span = spans[i];
+        unsigned long long int sequence = span.sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || n == copies.size())
+            continue;
+        Span& copy = copies[n];
+        copy.name = span.name;
+        copy.start = span.start;
+        copy.duration = span.duration;
+        copy.thread = span.thread;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (span.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+        if (n == 0 || copy.start < first_start)
+            first_start = copy.start;
+        n++;
+    }
+    
+    // Chrome expects the times in microseconds
+    file << std::fixed;
+    file.precision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const Span& span = copies[i];
+        if (i > 0)
+            file << ',';
+        file << "\n{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << span.thread << ",\"ts\":" << (span.start - first_start) / 1000.0
+             << ",\"dur\":" << span.duration / 1000.0 << '}';
+    }
+    file << "\n]}\n";
+    return 0;
+}
+
+void Timeline::clear()
+{
+    for (unsigned int i = 0; i < spans.size(); i++)
+        spans[i].sequence = 0;
+    next = 0;
+}
+
+unsigned int Timeline::size() const
+{
+    unsigned long long int n = next.load();
+    return n < TIMELINE_SPANS ? (unsigned int)n : TIMELINE_SPANS;
+}
+
+TraceSpan::TraceSpan(const char* name) : name(name)
+{
+    running = timeline.enabled;
+    if (running)
+        start = nanosecond_time();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (running)
+        timeline.record(name, start, nanosecond_time() - start);
+}
@@ -0,0 +1,81 @@
+//
+//  timeline.h
+//  Trusses
+//
+
+#ifndef __Trusses__timeline__
+#define __Trusses__timeline__
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+// Number of spans kept by the timeline, has to be a power of two
+#define TIMELINE_SPANS 65536u
+
+// Spans of time recorded by the threads (frames, simulation phases and
+// the tasks of the thread pool), which can be written out in the Chrome
+// trace event format and opened in chrome://tracing or Perfetto.
+//
+// The spans are kept in a ring buffer, so only the last TIMELINE_SPANS
+// are dumped. Threads claim the slots with an atomic counter and never
+// wait for each other. A slot which is being written while the timeline
+// is dumped is skipped.
+class Timeline
+{
+public:
+    Timeline();
+    
+    // Off by default. Can be switched while the other threads are
+    // recording (see Profiler::enabled).
+    std::atomic<bool> enabled;
+    
+    // Adds a span which started at start_ns and lasted duration_ns (see
+    // nanosecond_time). Name has to be a string literal, only the
+    // pointer is kept. Can be called from any thread.
+    void record(const char* name, unsigned long long int start_ns,
+                unsigned long long int duration_ns);
+    
+    // Writes the recorded spans as Chrome trace JSON. Returns 1 if
+    // the file couldn't be opened.
+    int dump(const std::string& filename) const;
+    
+    // Forgets all the spans
+    void clear();
+    
+    // Number of spans in the buffer
+    unsigned int size() const;
+    
+private:
+    struct Span
+    {
+        // Index of the span written in this slot plus one, zero while
+        // the slot is being written
+        std::atomic<unsigned long long int> sequence;
+        const char* name;
+        unsigned long long int start;
+        unsigned long long int duration;
+        int thread;
+    };
+    
+    std::vector<Span> spans;
+    std::atomic<unsigned long long int> next;
+};
+
+extern Timeline timeline;
+
+// Records the span between its construction and destruction
+// if the timeline is enabled
+class TraceSpan
+{
+public:
+    TraceSpan(const char* name);
+    ~TraceSpan();
+    
+private:
+    const char* name;
+    bool running;
+    unsigned long long int start;
+};
+
+#endif /* defined(__Trusses__timeline__) */
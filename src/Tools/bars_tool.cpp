@@ -56,7 +56,7 @@ void BarsTool::passive()
     
     if (mouse.particle_in_range())
     {
-        tool_pos = particles[mouse.closest_particle].position_;
+        tool_pos = particles[mouse.closest_particle].position();
         snapped = true;
     }
     else if (mouse.grid_in_range())
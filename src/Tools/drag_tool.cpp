@@ -13,29 +13,72 @@
 #include "temporary_label.h"
 #include "particle.h"
 #include "renderer.h"
+#include "journal.h"
+#include "simulation_thread.h"
 #ifdef __APPLE__
 #include <GLUT/glut.h>
 #else
 #include <GL/glut.h>
 #endif
 
+// Zeroes the acceleration of the released particles
+static void release_particles(const std::vector<int>& ids)
+{
+    for (int i = 0; i < ids.size(); i++)
+    {
+        int p_id = ids[i];
+        if (particles.exists(p_id))
+        {
+            particles[p_id].set_external_acceleration(Vector2d(0.0, 0.0));
+            journal.record_acceleration(p_id, Vector2d(0.0, 0.0));
+        }
+    }
+}
+
+// Pulls the free particles towards the target and moves the fixed ones by delta_pos
+static void pull_particles(const std::vector<int>& ids, Vector2d target,
+                           Vector2d delta_pos, double force)
+{
+    for (int i = 0; i < ids.size(); i++)
+    {
+        // TODO: See if it sometimes happen that the particle doesn't exist.
+        int p_id = ids[i];
+        if (!particles.exists(p_id))
+            return;
+        
+        Particle& p = particles[p_id];
+        if (p.fixed())
+        {
+            p.position() += delta_pos;
+            p.wake();
+            journal.record_position(p_id, p.position());
+        }
+        else
+        {
+            p.set_external_acceleration(force * (target - p.position()));
+            journal.record_acceleration(p_id, particle_store.acceleration[p.index()]);
+        }
+    }
+}
+
+// The particles are changed between the steps of the simulation thread,
+// and found in the snapshot that is drawn while the thread runs
 void DragTool::mouse_click(int button, int state)
 {
     if (state == GLUT_UP)
     {
         // Release dragged particles (zero their acceleration)
-        for (int i = 0; i < dragged_particles.size(); i++)
-        {
-            int p_id = dragged_particles[i];
-            if (particles.exists(p_id))
-                particles[p_id].external_acceleration_ = Vector2d(0.0, 0.0);
-        }
+        std::vector<int> released = dragged_particles;
+        simulation_thread.post([released]() {release_particles(released);});
         dragged_particles.clear();
     }
     else
     {
         // A particle was clicked and can be dragged around by mouse
-        mouse.particles_within(px_to_m(mouse.min_click_dist), dragged_particles);
+        if (simulation_thread.running())
+            simulation_thread.snapshot().particles_within(mouse.pos_world, px_to_m(mouse.min_click_dist), dragged_particles);
+        else
+            mouse.particles_within(px_to_m(mouse.min_click_dist), dragged_particles);
         mouse_previous = mouse.pos_world;
     }
 }
@@ -47,24 +90,16 @@ void DragTool::passive()
 
 void DragTool::drag()
 {
-    size_t no_part = dragged_particles.size();
-    for (int i = 0; i < no_part; i++)
+    if (!dragged_particles.empty())
     {
-        // TODO: See if it sometimes happen that the particle doesn't exist.
-        int p_id = dragged_particles[i];
-        if (!particles.exists(p_id))
-            return;
-        
-        Particle& p = particles[p_id];
-        if (p.fixed_)
+        std::vector<int> dragged = dragged_particles;
+        Vector2d target = mouse.pos_world;
+        Vector2d delta_pos = mouse.pos_world - mouse_previous;
+        double force = dragging_force / (window.get_scale() * dragged.size());
+        simulation_thread.post([dragged, target, delta_pos, force]()
         {
-            Vector2d delta_pos = mouse.pos_world - mouse_previous;
-            p.position_ += delta_pos;
-        }
-        else
-        {
-            p.external_acceleration_ = dragging_force * (mouse.pos_world - p.position_) / (window.get_scale() * no_part);
-        }
+            pull_particles(dragged, target, delta_pos, force);
+        });
     }
     mouse_previous = mouse.pos_world;
 }
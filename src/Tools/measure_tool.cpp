@@ -36,7 +36,7 @@ void MeasureTool::mouse_click(int button, int state)
     
     // If a particle was clicked
     if (clicked_p != -1)
-        selected_points.push_back(particles[clicked_p].position_);
+        selected_points.push_back(particles[clicked_p].position());
     else
     {
         Vector2d mouse_pos = mouse.grid_in_range() ? mouse.closest_grid : mouse.pos_world;
@@ -50,7 +50,7 @@ void SelectionTool::drag()
         Particle& p = particles.at(i);
         // TODO: Only particles that are lose to the selection
         // should be checked.
-        if (poly.point_inside(p.position_))
+        if (poly.point_inside(p.position()))
             selected.insert(p.id_);
     }
 }
@@ -7,29 +7,30 @@
 //
 
 #include "game.h"
-#include <sys/time.h>
 #include "particle.h"
 #include "bar.h"
+#include "material.h"
 #include "obstacle.h"
-#include "interface.h"
-#include "bars_tool.h"
-#include "drag_tool.h"
 #include "temporary_label.h"
-#include "button.h"
-#include "mouse.h"
 #include "settings.h"
 #include "various_math.h"
-
-#define RELAX_ITER 30
+#include "constraint_table.h"
+#include "solver.h"
+#include "islands.h"
+#include "thread_pool.h"
+#include "spatial_hash.h"
+#include "self_collision.h"
+#include "profiler.h"
+#include "timeline.h"
+#include "journal.h"
+#include <algorithm>
 
 Game game;
 
-// Returns system time in microseconds
+// Returns monotonic time in microseconds
 void microsecond_time (unsigned long long &t)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    t = (unsigned long long)tv.tv_usec + 1000000 * (unsigned long long)tv.tv_sec;
+    t = nanosecond_time() / 1000;
 }
 
 Game::Game()
@@ -39,16 +40,71 @@ Game::Game()
     prev_t = t;
     delta_t = 20000;
     simulation_time = 0;
+    
+    step = DEFAULT_STEP;
+    accumulator = 0.0;
+    max_substeps = DEFAULT_MAX_SUBSTEPS;
+    substeps = 0;
+    iterations = 0;
+    fast_forward_enabled = false;
+    
+    editor_entered = NULL;
+    simulation_entered = NULL;
+    game_reset = NULL;
 }
 
 void Game::update()
 {
     update_time();
-    if (simulation_running())
-        update_simulation();
+    advance(delta_t);
     update_labels();
 }
 
+void Game::update_frame()
+{
+    update_time();
+    update_labels();
+}
+
+void Game::advance(double elapsed_us)
+{
+    TraceSpan span("update");
+    substeps = 0;
+    iterations = 0;
+    
+    if (simulation_running() && fast_forward_enabled)
+    {
+        // Run as many steps as fit in the frame budget. A replayed
+        // journal can go back to the editor between the steps.
+        unsigned long long int start;
+        microsecond_time(start);
+        unsigned long long int now = start;
+        while (now - start < FAST_FORWARD_BUDGET && simulation_running())
+        {
+            update_simulation();
+            substeps++;
+            microsecond_time(now);
+        }
+        accumulator = 0.0;
+    }
+    else if (simulation_running())
+    {
+        // Run fixed steps to catch up with the real time
+        accumulator += elapsed_us;
+        while (accumulator >= step && substeps < max_substeps && simulation_running())
+        {
+            update_simulation();
+            accumulator -= step;
+            substeps++;
+        }
+        
+        // The simulation can't keep up. Drop the remaining time
+        // instead of accumulating it indefinitely.
+        if (accumulator >= step)
+            accumulator = 0.0;
+    }
+}
+
 void Game::update_time()
 {
     prev_t = t;
@@ -58,45 +114,190 @@ void Game::update_time()
 
 void Game::update_simulation()
 {
-    simulation_time += delta_t;
-    
-    // Update each particle's position by Verlet integration
-    for (int i = 0; i < particles.size(); i++)
-        particles.at(i).update();
+    TraceSpan span("step");
+    simulation_time += step;
     
-    // Use relaxation to satisfy the constraints imposed by bars
-    // Large RELAX_ITER means accurate simulation, and hence stiff bars
-    for (int j = 0; j < RELAX_ITER; j++)
-        for (int i = 0; i < bars.size(); i++)
-            bars.at(i).impose_constraint();
-    
-    // Collisions of particles with obstacles
-    for (int i = 0; i < obstacles.size(); i++)
-        obstacles.at(i).collide();
+    // Find the islands and compile the constraints if the topology has changed
+    if (!islands.valid())
+    {
+        TraceSpan rebuild_span("rebuild islands");
+        islands.rebuild();
+    }
+    constraints.set_island_order(solver.mode == ISLAND_SOLVER);
+    if (!constraints.valid())
+    {
+        TraceSpan rebuild_span("rebuild constraints");
+        constraints.rebuild();
+    }
     
-    // Update each bar and add see if it will be destroyed
     std::vector<int> bars_to_destroy;
-    for (int i = 0; i < bars.size(); i++)
+    if (solver.mode == ISLAND_SOLVER)
     {
-        Bar& b = bars.at(i);
-        if (b.is_fractured())
-            bars_to_destroy.push_back(b.id_);
+        step_islands(bars_to_destroy);
     }
+    else
+    {
+        // Update each particle's position by Verlet integration
+        {
+            ScopedTimer timer(PHASE_INTEGRATION);
+            Particle::update_all();
+        }
+        
+        // Use relaxation to satisfy the constraints imposed by bars
+        {
+            ScopedTimer timer(PHASE_RELAXATION);
+            solver.relax(constraints, particle_store, dt_s());
+        }
+        
+        // Contacts between the joints and bars of the structures
+        {
+            ScopedTimer timer(PHASE_COLLISION);
+            self_collision.solve(particle_store, dt_s());
+        }
+        
+        // Collisions of particles with obstacles. Each obstacle only
+        // checks the particles near its bounding box.
+        if (obstacles.size() > 0)
+        {
+            ScopedTimer timer(PHASE_COLLISION);
+            particle_grid.build(particle_store);
+            for (int i = 0; i < obstacles.size(); i++)
+                obstacles.at(i).collide(particle_grid);
+        }
+        
+        // Find the bars which will be destroyed
+        ScopedTimer timer(PHASE_FRACTURE);
+        constraints.find_fractured(particle_store, bars_to_destroy);
+    }
+    iterations += solver.last_iterations();
+    
+    // Put the islands at rest to sleep
+    islands.update_sleep(dt_s());
     
-    // Destroy each bar that was previously added to the list
-    for (int i = 0; i < bars_to_destroy.size(); i++)
-        Bar::destroy(bars_to_destroy[i]);
+    // Destroy everything queued in this step at once, so that a large
+    // structure tearing apart costs one compaction of each container
+    {
+        ScopedTimer timer(PHASE_FRACTURE);
+        Bar::destroy(bars_to_destroy);
+    }
     
-    // Destroy particles which are very far away
+    // Destroy the particles which are very far away
+    ScopedTimer timer(PHASE_CULLING);
     std::vector<int> particles_to_destroy;
-    for (int i = 0; i < particles.size(); i++)
+    for (int i = 0; i < particle_store.size(); i++)
     {
-        Particle& p = particles.at(i);
-        if (abs_d(p.position_.x) > HORIZON || abs_d(p.position_.y) > HORIZON)
-            particles_to_destroy.push_back(p.id_);
+        Vector2d pos = particle_store.position[i];
+        if (abs_d(pos.x) > HORIZON || abs_d(pos.y) > HORIZON)
+            particles_to_destroy.push_back(particles.at(i).id_);
+    }
+    Particle::destroy(particles_to_destroy);
+    
+    journal.step_done();
+}
+
+void Game::step_islands(std::vector<int>& bars_to_destroy)
+{
+    Particle::record_traces();
+    
+    // The awake islands, largest first so that
+    // the big ones don't hold up the end of the step
+    std::vector<int> awake;
+    for (unsigned int k = 0; k < islands.size(); k++)
+        if (!islands.asleep(k))
+            awake.push_back(k);
+    std::stable_sort(awake.begin(), awake.end(), [](int a, int b)
+    {
+        return islands.island_start[a+1] - islands.island_start[a] >
+               islands.island_start[b+1] - islands.island_start[b];
+    });
+    
+    std::vector<int> passes(awake.size(), 0);
+    std::vector<double> residuals(awake.size(), 0.0);
+    std::vector<std::vector<int> > fractured(awake.size());
+    const Vector2d gravity = Particle::gravity();
+    const double dt = dt_s();
+    
+    // Islands share no particles or bars, so each can go through the
+    // whole step independently. Obstacles are only read.
+    auto relax = [&](int t)
+    {
+        int k = awake[t];
+        const int* members = &islands.members[islands.island_start[k]];
+        unsigned int count = islands.island_start[k+1] - islands.island_start[k];
+        
+        {
+            ScopedTimer timer(PHASE_INTEGRATION);
+            particle_store.integrate(dt, gravity, members, count);
+        }
+        ScopedTimer timer(PHASE_RELAXATION);
+        passes[t] = solver.relax_island(constraints, particle_store, dt, k, residuals[t]);
+    };
+    auto finish = [&](int t)
+    {
+        int k = awake[t];
+        const int* members = &islands.members[islands.island_start[k]];
+        unsigned int count = islands.island_start[k+1] - islands.island_start[k];
+        
+        // Only the obstacles overlapping the paths of the particles can be hit
+        {
+            ScopedTimer timer(PHASE_COLLISION);
+            Vector2d box_min = particle_store.position[members[0]];
+            Vector2d box_max = box_min;
+            for (unsigned int j = 0; j < count; j++)
+            {
+                for (int end = 0; end < 2; end++)
+                {
+                    const Vector2d& p = end == 0 ? particle_store.position[members[j]]
+                                                 : particle_store.prev_position[members[j]];
+                    box_min = Vector2d(p.x < box_min.x ? p.x : box_min.x, p.y < box_min.y ? p.y : box_min.y);
+                    box_max = Vector2d(p.x > box_max.x ? p.x : box_max.x, p.y > box_max.y ? p.y : box_max.y);
+                }
+            }
+            for (int i = 0; i < obstacles.size(); i++)
+                if (obstacles.at(i).overlaps(box_min, box_max))
+                    for (unsigned int j = 0; j < count; j++)
+                        obstacles.at(i).collide(members[j]);
+        }
+        
+        ScopedTimer timer(PHASE_FRACTURE);
+        unsigned int first_batch = constraints.island_batch[k];
+        unsigned int last_batch = constraints.island_batch[k+1];
+        constraints.find_fractured(particle_store, constraints.colour_start[first_batch],
+                                   constraints.colour_start[last_batch], fractured[t]);
+    };
+    
+    // Contacts can join the islands, so they are handled between
+    // the relaxation and the obstacles of all the islands, in the
+    // same place as in the other solvers
+    if (self_collision.enabled)
+    {
+        thread_pool.run_tasks((int)awake.size(), relax);
+        {
+            ScopedTimer timer(PHASE_COLLISION);
+            self_collision.solve(particle_store, dt);
+        }
+        thread_pool.run_tasks((int)awake.size(), finish);
+    }
+    else
+    {
+        thread_pool.run_tasks((int)awake.size(), [&](int t)
+        {
+            relax(t);
+            finish(t);
+        });
+    }
+    
+    // The solver reports the slowest island
+    solver.iterations = 0;
+    solver.residual = 0.0;
+    for (unsigned int t = 0; t < awake.size(); t++)
+    {
+        if (passes[t] > solver.iterations)
+            solver.iterations = passes[t];
+        if (residuals[t] > solver.residual)
+            solver.residual = residuals[t];
+        bars_to_destroy.insert(bars_to_destroy.end(), fractured[t].begin(), fractured[t].end());
     }
-    for (int i = 0; i < particles_to_destroy.size(); i++)
-        Particle::destroy(particles_to_destroy[i]);
 }
 
 bool Game::simulation_running() const
@@ -106,53 +307,58 @@ bool Game::simulation_running() const
 
 void Game::enter_editor()
 {
-    Tool::set(current_tool, new BarsTool);
     simulation_is_running = false;
+    journal.record_mode(false);
     
-    temp_labels.clear();
-    TempLabel::create("Editor mode - you can draw the structure.", 0, 1.0, 0, -TOP_MARGIN, MODE_LABEL_TIME);
-    buttons.clear();
-    create_buttons_editor();
-    
-    mouse.min_click_dist = 10;
+    if (editor_entered)
+        editor_entered();
 }
 
 void Game::enter_simulation()
 {
-    Tool::set(current_tool, new DragTool);
     microsecond_time(t);
+    accumulator = 0.0;
     simulation_is_running = true;
+    islands.wake_all();
+    journal.record_mode(true);
     
-    temp_labels.clear();
-    TempLabel::create("Simulation mode - you can drag the joints.", 0, 1.0, 0, -TOP_MARGIN, MODE_LABEL_TIME);
-    buttons.clear();
-    create_buttons_simulation();
-    
-    mouse.min_click_dist = 20;
+    if (simulation_entered)
+        simulation_entered();
 }
 
 void Game::reset()
 {
     // Reset the entities
-    bars.clear();
-    particles.clear();
+    Bar::clear();
+    Particle::clear();
     obstacles.clear();
+    materials.reset();
     
     enter_editor();
     simulation_time = 0;
     
-    Tool::set(current_tool, new BarsTool);
-    
-    window.reset();
     settings.reset();
+    
+    if (game_reset)
+        game_reset();
 }
 
 double Game::dt_s() const
 {
-    return delta_t/1000000.0;
+    return step/1000000.0;
 }
 
 double Game::dt_us() const
+{
+    return step;
+}
+
+double Game::frame_dt_s() const
+{
+    return delta_t/1000000.0;
+}
+
+double Game::frame_dt_us() const
 {
     return delta_t;
 }
@@ -161,3 +367,60 @@ double Game::simulation_time_s() const
 {
     return simulation_time/1000000.0;
 }
+
+void Game::set_gravity(bool state)
+{
+    settings.set(GRAVITY, state);
+    islands.wake_all();
+}
+
+void Game::set_step(double step_us)
+{
+    if (step_us <= 0.0)
+        return;
+    
+    // Verlet integration stores the velocity as the difference between
+    // the current and the previous position. Rescale it, so that the
+    // velocities don't change with the step size.
+    double ratio = step_us / step;
+    for (int i = 0; i < particle_store.size(); i++)
+    {
+        Vector2d pos = particle_store.position[i];
+        particle_store.prev_position[i] = pos - ratio * (pos - particle_store.prev_position[i]);
+    }
+    
+    step = step_us;
+    accumulator = 0.0;
+}
+
+void Game::set_max_substeps(int n)
+{
+    if (n > 0)
+        max_substeps = n;
+}
+
+int Game::get_max_substeps() const
+{
+    return max_substeps;
+}
+
+void Game::set_fast_forward(bool state)
+{
+    fast_forward_enabled = state;
+    accumulator = 0.0;
+}
+
+bool Game::fast_forward() const
+{
+    return fast_forward_enabled;
+}
+
+int Game::steps_last_frame() const
+{
+    return substeps;
+}
+
+int Game::iterations_last_frame() const
+{
+    return iterations;
+}
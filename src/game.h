@@ -9,9 +9,19 @@
 #ifndef __Trusses__game__
 #define __Trusses__game__
 
+#include <vector>
+
 #define HORIZON 1000
 
-#include "window.h"
+// Default length of one simulation step (in microseconds)
+#define DEFAULT_STEP 5000
+
+// Default maximum number of simulation steps run in one frame
+#define DEFAULT_MAX_SUBSTEPS 8
+
+// Wall-clock time (in microseconds) that the fast-forward mode
+// can spend on the simulation in one frame
+#define FAST_FORWARD_BUDGET 15000
 
 class Game
 {
@@ -19,9 +29,19 @@ public:
     Game();
     
     // Updates time and simulation. Should be called
-    // each frame.
+    // each frame. The simulation is advanced in fixed steps.
     void update();
     
+    // Updates the time and the labels without simulating. Used instead
+    // of update() while another thread runs the simulation.
+    void update_frame();
+    
+    // Runs the simulation steps which follow elapsed_us of real time
+    // (or fill the fast-forward budget). The rest of the time is carried
+    // over to the next call. Called by update(), or by a thread running
+    // the simulation, which keeps its own time.
+    void advance(double elapsed_us);
+    
     // Enters the editor mode
     void enter_editor();
     
@@ -34,30 +54,88 @@ public:
     // Resets everything
     void reset();
     
-    // Returns the time step in seconds
+    // Returns the simulation time step in seconds
     double dt_s() const;
     
-    // Returns the time step in microseconds
+    // Returns the simulation time step in microseconds
     double dt_us() const;
     
+    // Returns the wall-clock duration of the last frame in seconds
+    double frame_dt_s() const;
+    
+    // Returns the wall-clock duration of the last frame in microseconds
+    double frame_dt_us() const;
+    
     // Returns the total simulated time in seconds
     double simulation_time_s() const;
     
+    // Sets the length of the simulation step (in microseconds).
+    // Velocities of the particles are preserved.
+    void set_step(double step_us);
+    
+    // Turns gravity on or off. Structures which fell asleep are woken
+    // up, as they are no longer at rest.
+    void set_gravity(bool state);
+    
+    // Maximum number of simulation steps run in one frame. If the
+    // simulation can't keep up, it runs slower than real time.
+    void set_max_substeps(int n);
+    int get_max_substeps() const;
+    
+    // In the fast-forward mode the simulation runs as many steps
+    // as fit in FAST_FORWARD_BUDGET, regardless of the real time.
+    void set_fast_forward(bool state);
+    bool fast_forward() const;
+    
+    // Number of simulation steps run during the last frame
+    int steps_last_frame() const;
+    
+    // Number of relaxation passes run during the last frame
+    int iterations_last_frame() const;
+    
+    // Advances the simulation by one step. Can be called directly
+    // when there is no real time to follow (e.g. without graphics).
+    void update_simulation();
+    
+    // Called after entering the editor mode, entering the simulation
+    // mode and resetting the game, so that the interface can follow.
+    // They are NULL when running without the interface.
+    void (*editor_entered)();
+    void (*simulation_entered)();
+    void (*game_reset)();
+    
 private:
     bool simulation_is_running;
+    bool fast_forward_enabled;
     
     void update_time();
-    void update_simulation();
+    
+    // Runs one step of each awake island in parallel (ISLAND_SOLVER)
+    // and appends the ids of the fractured bars
+    void step_islands(std::vector<int>& bars_to_destroy);
     
     // In microseconds
     unsigned long long int t;
     unsigned long long int prev_t;
     unsigned long long int simulation_time;
     
-    // In seconds
+    // Duration of the last frame (in microseconds)
     double delta_t;
+    
+    // Length of the simulation step (in microseconds)
+    double step;
+    
+    // Real time which hasn't been simulated yet (in microseconds)
+    double accumulator;
+    
+    int max_substeps;
+    int substeps;
+    int iterations;
 };
 
 extern Game game;
 
+// Returns system time in microseconds
+void microsecond_time(unsigned long long &t);
+
 #endif /* defined(__Trusses__game__) */
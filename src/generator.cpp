@@ -0,0 +1,527 @@
+//
+//  generator.cpp
+//  Trusses
+//
+
+#include "generator.h"
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "particle.h"
+#include "bar.h"
+#include "game.h"
+#include "temporary_label.h"
+#include "various_math.h"
+
+// Generated structures are scaled down to fit inside this size
+static const double max_extent = 0.9 * HORIZON;
+
+// * * * * * * * * * * //
+void create_cloth(int n, double d, Vector2d bottom_left_corner, bool fix, bool braced)
+{
+    if (n < 1)
+        return;
+    
+    std::vector<Vector2d> positions;
+    std::vector<char> fixed;
+    positions.reserve(n * n);
+    fixed.reserve(n * n);
+    for (int j = 0; j < n; j++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            positions.push_back(bottom_left_corner + Vector2d(i * d, j * d));
+            fixed.push_back(fix && j == n-1);
+        }
+    }
+    std::vector<int> ids;
+    Particle::create(positions, fixed, ids);
+    
+    std::vector<int> ends;
+    ends.reserve((braced ? 8 : 4) * n * n);
+    for (int j = 0; j < n; j++)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            int p = ids[j * n + i];
+            if (i + 1 < n)
+            {
+                ends.push_back(p);
+                ends.push_back(ids[j * n + i + 1]);
+            }
+            if (j + 1 < n)
+            {
+                ends.push_back(p);
+                ends.push_back(ids[(j + 1) * n + i]);
+            }
+            if (braced && i + 1 < n && j + 1 < n)
+            {
+                ends.push_back(p);
+                ends.push_back(ids[(j + 1) * n + i + 1]);
+                ends.push_back(ids[j * n + i + 1]);
+                ends.push_back(ids[(j + 1) * n + i]);
+            }
+        }
+    }
+    Bar::create(ends);
+}
+
+void create_warren_bridge(int panels, double d, Vector2d centre)
+{
+    if (panels < 1)
+        return;
+    
+    // Equilateral triangles, the bottom chord comes first
+    double height = d * std::sqrt(3.0) / 2.0;
+    double x0 = centre.x - panels * d / 2.0;
+    std::vector<Vector2d> positions;
+    std::vector<char> fixed;
+    for (int i = 0; i <= panels; i++)
+    {
+        positions.push_back(Vector2d(x0 + i * d, centre.y));
+        fixed.push_back(i == 0 || i == panels);
+    }
+    for (int i = 0; i < panels; i++)
+    {
+        positions.push_back(Vector2d(x0 + (i + 0.5) * d, centre.y + height));
+        fixed.push_back(false);
+    }
+    std::vector<int> ids;
+    Particle::create(positions, fixed, ids);
+    
+    const int* bottom = &ids[0];
+    const int* top = &ids[panels + 1];
+    std::vector<int> ends;
+    for (int i = 0; i < panels; i++)
+    {
+        int pairs[] = {bottom[i], bottom[i+1], bottom[i], top[i], top[i], bottom[i+1]};
+        ends.insert(ends.end(), pairs, pairs + 6);
+        if (i + 1 < panels)
+        {
+            ends.push_back(top[i]);
+            ends.push_back(top[i+1]);
+        }
+    }
+    Bar::create(ends);
+}
+
+void create_pratt_bridge(int panels, double d, Vector2d centre)
+{
+    if (panels < 2)
+        return;
+    
+    // The top chord spans the inner nodes of the bottom chord
+    double x0 = centre.x - panels * d / 2.0;
+    std::vector<Vector2d> positions;
+    std::vector<char> fixed;
+    for (int i = 0; i <= panels; i++)
+    {
+        positions.push_back(Vector2d(x0 + i * d, centre.y));
+        fixed.push_back(i == 0 || i == panels);
+    }
+    for (int i = 1; i < panels; i++)
+    {
+        positions.push_back(Vector2d(x0 + i * d, centre.y + d));
+        fixed.push_back(false);
+    }
+    std::vector<int> ids;
+    Particle::create(positions, fixed, ids);
+    
+    // top[i] is above bottom[i] for 0 < i < panels
+    const int* bottom = &ids[0];
+    const int* top = &ids[panels];
+    std::vector<int> ends;
+    for (int i = 0; i < panels; i++)
+    {
+        ends.push_back(bottom[i]);
+        ends.push_back(bottom[i+1]);
+        if (i > 0)
+        {
+            ends.push_back(bottom[i]);
+            ends.push_back(top[i]);
+        }
+        if (i > 0 && i + 1 < panels)
+        {
+            ends.push_back(top[i]);
+            ends.push_back(top[i+1]);
+        }
+        
+        // End posts, then diagonals sloping down towards the middle
+        if (i == 0)
+        {
+            ends.push_back(bottom[0]);
+            ends.push_back(top[1]);
+        }
+        else if (i == panels - 1)
+        {
+            ends.push_back(top[i]);
+            ends.push_back(bottom[panels]);
+        }
+        else if (2 * i + 1 < panels)
+        {
+            ends.push_back(top[i]);
+            ends.push_back(bottom[i+1]);
+        }
+        else
+        {
+            ends.push_back(bottom[i]);
+            ends.push_back(top[i+1]);
+        }
+    }
+    Bar::create(ends);
+}
+
+void create_tower(int levels, double d, Vector2d base)
+{
+    if (levels < 1)
+        return;
+    
+    std::vector<Vector2d> positions;
+    std::vector<char> fixed;
+    for (int j = 0; j <= levels; j++)
+    {
+        positions.push_back(base + Vector2d(-d / 2.0, j * d));
+        positions.push_back(base + Vector2d(d / 2.0, j * d));
+        fixed.push_back(j == 0);
+        fixed.push_back(j == 0);
+    }
+    std::vector<int> ids;
+    Particle::create(positions, fixed, ids);
+    
+    std::vector<int> ends;
+    for (int j = 0; j < levels; j++)
+    {
+        const int* p = &ids[2 * j];
+        int pairs[] = {p[0], p[2], p[1], p[3], p[0], p[3], p[1], p[2], p[2], p[3]};
+        ends.insert(ends.end(), pairs, pairs + 10);
+    }
+    ends.push_back(ids[0]);
+    ends.push_back(ids[1]);
+    Bar::create(ends);
+}
+
+// * * * * * * * * * * //
+// Triangles of the Delaunay triangulation are kept anti-clockwise.
+// n[i] is the neighbour across the edge opposite v[i], -1 if none.
+struct DelaunayTriangle
+{
+    int v[3];
+    int n[3];
+};
+
+static double orientation(const Vector2d& a, const Vector2d& b, const Vector2d& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// True if d is inside the circumcircle of the anti-clockwise triangle abc
+static bool in_circumcircle(const Vector2d& a, const Vector2d& b, const Vector2d& c, const Vector2d& d)
+{
+    double ax = a.x - d.x, ay = a.y - d.y;
+    double bx = b.x - d.x, by = b.y - d.y;
+    double cx = c.x - d.x, cy = c.y - d.y;
+    double det = (ax * ax + ay * ay) * (bx * cy - cx * by)
+               - (bx * bx + by * by) * (ax * cy - cx * ay)
+               + (cx * cx + cy * cy) * (ax * by - bx * ay);
+    return det > 0.0;
+}
+
+// Indices of the points in the order of a grid over them, its rows
+// taken in alternating directions, so that consecutive points are
+// close to each other. Centre and size are set to the centre and the
+// side of the bounding square.
+static void grid_order(const std::vector<Vector2d>& points, std::vector<int>& order,
+                       Vector2d& centre, double& size)
+{
+    int n = (int)points.size();
+    order.clear();
+    if (n == 0)
+        return;
+    
+    Vector2d box_min = points[0];
+    Vector2d box_max = points[0];
+    for (int i = 1; i < n; i++)
+    {
+        box_min = Vector2d(min(box_min.x, points[i].x), min(box_min.y, points[i].y));
+        box_max = Vector2d(max(box_max.x, points[i].x), max(box_max.y, points[i].y));
+    }
+    centre = 0.5 * (box_min + box_max);
+    size = max(box_max.x - box_min.x, box_max.y - box_min.y);
+    
+    int cells = (int)std::sqrt((double)n) + 1;
+    std::vector<std::pair<long long, int> > keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        int row = size > 0.0 ? (int)((points[i].y - box_min.y) / size * (cells - 1)) : 0;
+        int col = size > 0.0 ? (int)((points[i].x - box_min.x) / size * (cells - 1)) : 0;
+        if (row % 2 == 1)
+            col = cells - 1 - col;
+        keys[i] = std::make_pair((long long)row * cells + col, i);
+    }
+    std::sort(keys.begin(), keys.end());
+    order.resize(n);
+    for (int i = 0; i < n; i++)
+        order[i] = keys[i].second;
+}
+
+// Appends pairs of indices of the points joined by the Delaunay
+// triangulation. Uses Bowyer-Watson: the points are inserted in the
+// order of a grid over them, so that each one is found by a short walk
+// from the previous one. Returns 1 and appends nothing if no triangle
+// contains one of the points, which only rounding errors can cause.
+static int delaunay_edges(const std::vector<Vector2d>& points, std::vector<int>& edges)
+{
+    int n = (int)points.size();
+    if (n < 3)
+        return 0;
+    
+    std::vector<int> order;
+    Vector2d c;
+    double size;
+    grid_order(points, order, c, size);
+    if (size <= 0.0)
+        return 0;
+    
+    // A large triangle around all the points, removed at the end
+    std::vector<Vector2d> p = points;
+    p.push_back(c + Vector2d(-20 * size, -size));
+    p.push_back(c + Vector2d(20 * size, -size));
+    p.push_back(c + Vector2d(0.0, 20 * size));
+    
+    std::vector<DelaunayTriangle> triangles;
+    DelaunayTriangle super = {{n, n+1, n+2}, {-1, -1, -1}};
+    triangles.push_back(super);
+    
+    std::vector<int> bad_mark(1, -1);
+    std::vector<int> bad;
+    std::vector<int> boundary;
+    std::vector<int> free_slots;
+    std::vector<int> created;
+    int last = 0;
+    for (int k = 0; k < n; k++)
+    {
+        int q = order[k];
+        const Vector2d& pq = p[q];
+        
+        // Walk towards the point until it's inside the triangle
+        int t = last;
+        int steps = 0;
+        bool walking = true;
+        while (walking && steps++ < (int)triangles.size())
+        {
+            walking = false;
+            const DelaunayTriangle& tri = triangles[t];
+            for (int i = 0; i < 3; i++)
+            {
+                if (orientation(p[tri.v[(i+1)%3]], p[tri.v[(i+2)%3]], pq) < 0.0 && tri.n[i] != -1)
+                {
+                    t = tri.n[i];
+                    walking = true;
+                    break;
+                }
+            }
+        }
+        
+        // The walk can cycle when points are collinear or nearly so.
+        // The cavity has to start in the right triangle, so look
+        // through all of them instead.
+        if (walking)
+        {
+            std::vector<char> is_free(triangles.size(), false);
+            for (int i = 0; i < free_slots.size(); i++)
+                is_free[free_slots[i]] = true;
+            t = -1;
+            for (int j = 0; j < triangles.size() && t == -1; j++)
+            {
+                const DelaunayTriangle& tri = triangles[j];
+                if (!is_free[j] &&
+                    orientation(p[tri.v[1]], p[tri.v[2]], pq) >= 0.0 &&
+                    orientation(p[tri.v[2]], p[tri.v[0]], pq) >= 0.0 &&
+                    orientation(p[tri.v[0]], p[tri.v[1]], pq) >= 0.0)
+                    t = j;
+            }
+            if (t == -1)
+                return 1;
+        }
+        
+        // Triangles whose circumcircles contain the point form the cavity
+        bad.clear();
+        bad.push_back(t);
+        bad_mark[t] = k;
+        for (int b = 0; b < bad.size(); b++)
+        {
+            const DelaunayTriangle& tri = triangles[bad[b]];
+            for (int i = 0; i < 3; i++)
+            {
+                int nb = tri.n[i];
+                if (nb == -1 || bad_mark[nb] == k)
+                    continue;
+                const DelaunayTriangle& other = triangles[nb];
+                if (in_circumcircle(p[other.v[0]], p[other.v[1]], p[other.v[2]], pq))
+                {
+                    bad_mark[nb] = k;
+                    bad.push_back(nb);
+                }
+            }
+        }
+        
+        // Edges of the cavity as (a, b, outer neighbour)
+        boundary.clear();
+        for (int b = 0; b < bad.size(); b++)
+        {
+            const DelaunayTriangle& tri = triangles[bad[b]];
+            for (int i = 0; i < 3; i++)
+            {
+                int nb = tri.n[i];
+                if (nb != -1 && bad_mark[nb] == k)
+                    continue;
+                boundary.push_back(tri.v[(i+1)%3]);
+                boundary.push_back(tri.v[(i+2)%3]);
+                boundary.push_back(nb);
+            }
+        }
+        free_slots.insert(free_slots.end(), bad.begin(), bad.end());
+        
+        // Connect the point to every edge of the cavity
+        int first_new = -1;
+        created.resize(boundary.size() / 3);
+        for (int e = 0; e < created.size(); e++)
+        {
+            int a = boundary[3*e];
+            int b = boundary[3*e + 1];
+            int outer = boundary[3*e + 2];
+            DelaunayTriangle tri = {{q, a, b}, {outer, -1, -1}};
+            int slot;
+            if (!free_slots.empty())
+            {
+                slot = free_slots.back();
+                free_slots.pop_back();
+                triangles[slot] = tri;
+            }
+            else
+            {
+                slot = (int)triangles.size();
+                triangles.push_back(tri);
+                bad_mark.push_back(-1);
+            }
+            created[e] = slot;
+            if (first_new == -1)
+                first_new = slot;
+            
+            // The outer triangle has the same edge the other way round. Its
+            // neighbours can't be compared with the bad triangle, whose slot
+            // may already have been reused.
+            if (outer != -1)
+            {
+                for (int i = 0; i < 3; i++)
+                    if (triangles[outer].v[(i+1)%3] == b && triangles[outer].v[(i+2)%3] == a)
+                        triangles[outer].n[i] = slot;
+            }
+        }
+        
+        // The new triangles around the point are neighbours of each other
+        for (int e = 0; e < created.size(); e++)
+        {
+            for (int f = 0; f < created.size(); f++)
+            {
+                if (boundary[3*f] == boundary[3*e + 1])
+                {
+                    triangles[created[e]].n[1] = created[f];
+                    triangles[created[f]].n[2] = created[e];
+                    break;
+                }
+            }
+        }
+        last = first_new;
+    }
+    
+    // Each edge is taken from the triangle with the lower index,
+    // the edges of the large triangle are left out
+    std::vector<char> alive(triangles.size(), true);
+    for (int i = 0; i < free_slots.size(); i++)
+        alive[free_slots[i]] = false;
+    for (int t = 0; t < triangles.size(); t++)
+    {
+        if (!alive[t])
+            continue;
+        const DelaunayTriangle& tri = triangles[t];
+        for (int i = 0; i < 3; i++)
+        {
+            int a = tri.v[(i+1)%3];
+            int b = tri.v[(i+2)%3];
+            if (a >= n || b >= n)
+                continue;
+            if (tri.n[i] == -1 || tri.n[i] > t)
+            {
+                edges.push_back(a);
+                edges.push_back(b);
+            }
+        }
+    }
+    return 0;
+}
+
+void create_random_truss(int n, double size, Vector2d centre, unsigned int seed)
+{
+    if (n < 3)
+        return;
+    
+    srand(seed);
+    double bottom = centre.y - size / 2.0;
+    std::vector<Vector2d> positions(n);
+    std::vector<char> fixed(n);
+    for (int i = 0; i < n; i++)
+        positions[i] = centre + Vector2d(random(size / 2.0), random(size / 2.0));
+    
+    // Neighbouring particles get close ids, which keeps the bars
+    // touching them close in memory
+    std::vector<int> order;
+    Vector2d box_centre;
+    double extent;
+    grid_order(positions, order, box_centre, extent);
+    std::vector<Vector2d> sorted(n);
+    for (int i = 0; i < n; i++)
+    {
+        sorted[i] = positions[order[i]];
+        fixed[i] = sorted[i].y < bottom + 0.02 * size;
+    }
+    positions.swap(sorted);
+    
+    std::vector<int> ends;
+    if (delaunay_edges(positions, ends))
+    {
+        issue_label("Triangulation failed", WARNING_LABEL_TIME);
+        return;
+    }
+    std::vector<int> ids;
+    Particle::create(positions, fixed, ids);
+    for (int i = 0; i < ends.size(); i++)
+        ends[i] = ids[ends[i]];
+    Bar::create(ends);
+}
+
+// * * * * * * * * * * //
+int generate(const std::string& type, int size)
+{
+    if (size < 2)
+        return 1;
+    
+    Vector2d origin(0.0, 0.0);
+    if (type == "cloth" || type == "bracedcloth")
+    {
+        double d = min(0.5, max_extent / size);
+        create_cloth(size, d, Vector2d(-size * d / 2.0, 0.0), true, type == "bracedcloth");
+    }
+    else if (type == "bridge")
+        create_warren_bridge(size, min(2.0, max_extent / size), origin);
+    else if (type == "pratt")
+        create_pratt_bridge(size, min(2.0, max_extent / size), origin);
+    else if (type == "tower")
+        create_tower(size, min(1.0, max_extent / size), origin);
+    else if (type == "delaunay")
+        create_random_truss(size, min(std::sqrt((double)size), max_extent), origin, 1);
+    else
+        return 1;
+    return 0;
+}
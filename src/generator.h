@@ -0,0 +1,42 @@
+//
+//  generator.h
+//  Trusses
+//
+
+#ifndef __Trusses__generator__
+#define __Trusses__generator__
+
+#include <string>
+#include "vector2d.h"
+
+// Generated structures are added to the current scene. They are built
+// in bulk (see Particle::create and Bar::create for many elements at
+// once), so even structures of millions of elements take well under a
+// second. They are scaled down if they wouldn't fit inside HORIZON.
+
+// Square cloth of n by n particles spaced by d. If fix is true the top
+// row is fixed, if braced is true each square gets both diagonals.
+void create_cloth(int n, double d, Vector2d bottom_left_corner, bool fix, bool braced = false);
+
+// Bridges of the given number of panels of length d, supported at both
+// ends. A Warren truss has only diagonals, a Pratt truss has verticals
+// as well and its diagonals slope down towards the middle.
+void create_warren_bridge(int panels, double d, Vector2d centre);
+void create_pratt_bridge(int panels, double d, Vector2d centre);
+
+// A tower of square cells of side d, braced with both diagonals
+// and fixed at the base
+void create_tower(int levels, double d, Vector2d base);
+
+// Bars along the Delaunay triangulation of n random points in a square
+// of side size. The points near the bottom edge are fixed.
+void create_random_truss(int n, double size, Vector2d centre, unsigned int seed);
+
+// Generates the named structure (cloth, bracedcloth, bridge, pratt,
+// tower or delaunay) of the given size around the origin. The size is
+// the number of particles on a side of a cloth, of panels of a bridge,
+// of levels of a tower or of points of a Delaunay truss. Returns 1 if
+// the type isn't known.
+int generate(const std::string& type, int size);
+
+#endif /* defined(__Trusses__generator__) */
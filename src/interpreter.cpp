@@ -10,14 +10,29 @@
 
 #include <sstream>
 #include <vector>
+#include <cmath>
 
 #include "particle.h"
 #include "bar.h"
+#include "material.h"
+#include "obstacle.h"
 #include "save.h"
+#include "generator.h"
 #include "temporary_label.h"
 #include "window.h"
 #include "settings.h"
 #include "game.h"
+#include "solver.h"
+#include "static_solver.h"
+#include "islands.h"
+#include "spatial_hash.h"
+#include "self_collision.h"
+#include "thread_pool.h"
+#include "relax_kernels.h"
+#include "various_math.h"
+#include "profiler.h"
+#include "timeline.h"
+#include "journal.h"
 
 using namespace std;
 
@@ -101,6 +116,10 @@ void Interpreter::interpret() const
     
     string first_word = words[0];
     
+    // Everything except the journal itself can change the replayed run
+    if (first_word != "record" && first_word != "replay")
+        journal.record_command(command);
+    
     if (first_word == "ids")
     {
         if (words_number == 2 && words[1] == "on")
@@ -114,9 +133,9 @@ void Interpreter::interpret() const
     else if (first_word == "gravity")
     {
         if (words_number == 2 && words[1] == "on")
-            settings.set(GRAVITY, true);
+            game.set_gravity(true);
         else if (words_number == 2 && words[1] == "off")
-            settings.set(GRAVITY, false);
+            game.set_gravity(false);
         else
             issue_label("Usage: gravity <on/off>", INFO_LABEL_TIME);
     }
@@ -131,6 +150,406 @@ void Interpreter::interpret() const
             issue_label("Usage: grid <on/off>", INFO_LABEL_TIME);
     }
     
+    else if (first_word == "simthread")
+    {
+        if (words_number == 2 && words[1] == "on")
+            settings.set(THREADED, true);
+        else if (words_number == 2 && words[1] == "off")
+            settings.set(THREADED, false);
+        else
+            issue_label("Usage: simthread <on/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "timestep")
+    {
+        if (words_number == 1)
+            cout << "timestep=" << game.dt_us() / 1000.0 << " ms" << endl;
+        else if (types == "wn")
+        {
+            double new_step = get_number<double>(words[1]);
+            if (new_step <= 0.0)
+                issue_label("Time step has to be positive", WARNING_LABEL_TIME);
+            else
+                game.set_step(new_step * 1000.0);
+        }
+        else
+            issue_label("Usage: timestep <milliseconds>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "substeps")
+    {
+        if (words_number == 1)
+            cout << "substeps=" << game.get_max_substeps() << endl;
+        else if (types == "wn")
+        {
+            int n = get_number<int>(words[1]);
+            if (n < 1)
+                issue_label("Number of substeps has to be positive", WARNING_LABEL_TIME);
+            else
+                game.set_max_substeps(n);
+        }
+        else
+            issue_label("Usage: substeps <int>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "fastforward")
+    {
+        if (words_number == 2 && words[1] == "on")
+            game.set_fast_forward(true);
+        else if (words_number == 2 && words[1] == "off")
+            game.set_fast_forward(false);
+        else
+            issue_label("Usage: fastforward <on/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "solver")
+    {
+        if (words_number == 1)
+        {
+            const char* names[] = {"serial", "parallel", "islands"};
+            cout << "solver=" << names[solver.mode] << endl;
+        }
+        else if (words_number == 2 && words[1] == "serial")
+            solver.mode = SERIAL_SOLVER;
+        else if (words_number == 2 && words[1] == "parallel")
+            solver.mode = COLOURED_SOLVER;
+        else if (words_number == 2 && words[1] == "islands")
+            solver.mode = ISLAND_SOLVER;
+        else
+            issue_label("Usage: solver <serial/parallel/islands>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "simd")
+    {
+        if (words_number == 1)
+            cout << "simd=" << relax_kernel_name(solver.vectorised ? fastest_relax_kernel() : relax_scalar) << endl;
+        else if (words_number == 2 && words[1] == "on")
+            solver.vectorised = true;
+        else if (words_number == 2 && words[1] == "off")
+            solver.vectorised = false;
+        else
+            issue_label("Usage: simd <on/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "xpbd")
+    {
+        if (words_number == 1)
+            cout << "xpbd=" << (solver.method == XPBD_RELAX ? "on" : "off") << endl;
+        else if (words_number == 2 && words[1] == "on")
+            solver.method = XPBD_RELAX;
+        else if (words_number == 2 && words[1] == "off")
+            solver.method = PBD_RELAX;
+        else
+            issue_label("Usage: xpbd <on/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "compliance")
+    {
+        if (types == "wn" && get_number<double>(words[1]) >= 0)
+        {
+            // Compliance of a 1 m bar of the current material
+            double c = get_number<double>(words[1]);
+            Material m = materials.get(materials.current);
+            if (m.compliance < 0.0)
+            {
+                m.modulus = c > 0.0 ? 1.0 / c : INFINITY;
+                materials.set(m);
+            }
+            
+            // Scenes from before there were materials: as it used to, the
+            // command changes all the bars but not the ones added later
+            else
+            {
+                for (unsigned int i = 0; i < materials.size(); i++)
+                {
+                    if (materials.compliance[i] < 0.0)
+                        continue;
+                    Material l = materials.get(i);
+                    l.modulus = c > 0.0 ? 1.0 / c : INFINITY;
+                    l.compliance = c;
+                    materials.set(l);
+                }
+                int i = materials.legacy(LEGACY_COMPLIANCE);
+                if (i != -1)
+                    materials.current = i;
+            }
+        }
+        else
+            issue_label("Usage: compliance <non-negative number>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "material")
+    {
+        if (words_number == 1)
+        {
+            for (unsigned int i = 0; i < materials.size(); i++)
+            {
+                cout << (i == materials.current ? "* " : "  ") << materials.name[i]
+                     << " modulus=" << materials.modulus[i] << " yield=" << materials.yield_strain[i]
+                     << " density=" << materials.density[i] << " tension=" << materials.tension_limit[i]
+                     << " compression=" << materials.compression_limit[i];
+                if (materials.compliance[i] >= 0.0)
+                    cout << " compliance=" << materials.compliance[i];
+                cout << endl;
+            }
+        }
+        else if (types == "ww")
+        {
+            int i = materials.find(words[1]);
+            if (i != -1)
+                materials.current = i;
+            else
+                issue_label("This material does not exist", WARNING_LABEL_TIME);
+        }
+        else if (types == "wwnnnnn" && get_number<double>(words[2]) > 0 &&
+                 get_number<double>(words[3]) > 0 && get_number<double>(words[4]) >= 0)
+        {
+            Material m;
+            m.compliance = -1.0;
+            m.name = words[1];
+            m.modulus = get_number<double>(words[2]);
+            m.yield_strain = get_number<double>(words[3]);
+            m.density = get_number<double>(words[4]);
+            m.tension_limit = get_number<double>(words[5]);
+            m.compression_limit = get_number<double>(words[6]);
+            int i = materials.set(m);
+            if (i != -1)
+                materials.current = i;
+            else
+                issue_label("Too many materials", WARNING_LABEL_TIME);
+        }
+        else
+            issue_label("Usage: material <name> <modulus> <yield strain> <density> <tension limit> <compression limit>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "relax")
+    {
+        if (words_number == 1)
+            cout << "relax=" << solver.min_iterations << " " << solver.max_iterations
+                 << " " << solver.tolerance << endl;
+        else if (types == "wnnn")
+        {
+            int min_iter = get_number<int>(words[1]);
+            int max_iter = get_number<int>(words[2]);
+            double tol = get_number<double>(words[3]);
+            if (min_iter < 1 || max_iter < min_iter || tol < 0)
+                issue_label("Expected 0 < min <= max and tolerance >= 0", WARNING_LABEL_TIME);
+            else
+            {
+                solver.min_iterations = min_iter;
+                solver.max_iterations = max_iter;
+                solver.tolerance = tol;
+            }
+        }
+        else
+            issue_label("Usage: relax <min iterations> <max iterations> <tolerance>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "iterations")
+    {
+        cout << "iterations=" << game.iterations_last_frame() << " (last frame), "
+             << solver.last_iterations() << " (last step), residual="
+             << solver.last_residual() << endl;
+    }
+    
+    else if (first_word == "sleep")
+    {
+        if (words_number == 1)
+            cout << "sleep=" << (islands.enabled ? "on" : "off") << ", "
+                 << islands.sleeping_particles() << " particles asleep" << endl;
+        else if (words_number == 2 && words[1] == "on")
+            islands.enabled = true;
+        else if (words_number == 2 && words[1] == "off")
+        {
+            islands.enabled = false;
+            islands.wake_all();
+        }
+        else
+            issue_label("Usage: sleep <on/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "sdf")
+    {
+        if (words_number == 1)
+        {
+            if (Obstacle::field_cell_size > 0.0)
+                cout << "sdf=" << Obstacle::field_cell_size << endl;
+            else
+                cout << "sdf=off" << endl;
+        }
+        else if (words_number == 2 && words[1] == "off")
+        {
+            Obstacle::field_cell_size = 0.0;
+            for (int i = 0; i < obstacles.size(); i++)
+                obstacles.at(i).clear_field();
+        }
+        else if (types == "wn" && get_number<double>(words[1]) > 0)
+        {
+            Obstacle::field_cell_size = get_number<double>(words[1]);
+            for (int i = 0; i < obstacles.size(); i++)
+                obstacles.at(i).build_field(Obstacle::field_cell_size);
+        }
+        else
+            issue_label("Usage: sdf <cell size/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "cellsize")
+    {
+        if (words_number == 1)
+            cout << "cellsize=" << particle_grid.cell_size << endl;
+        else if (types == "wn" && get_number<double>(words[1]) > 0)
+            particle_grid.cell_size = get_number<double>(words[1]);
+        else
+            issue_label("Usage: cellsize <positive number>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "selfcollide")
+    {
+        if (words_number == 1)
+        {
+            cout << "selfcollide=" << (self_collision.enabled ? "on" : "off") << ", radius="
+                 << self_collision.radius << ", " << self_collision.contacts()
+                 << " contacts in the last step" << endl;
+        }
+        else if (words_number == 2 && words[1] == "on")
+            self_collision.enabled = true;
+        else if (words_number == 2 && words[1] == "off")
+            self_collision.enabled = false;
+        else if (types == "wn" && get_number<double>(words[1]) > 0)
+        {
+            self_collision.radius = get_number<double>(words[1]);
+            self_collision.enabled = true;
+        }
+        else
+            issue_label("Usage: selfcollide <on/off/joint radius>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "static")
+    {
+        if (words_number == 1 || (words_number == 2 && words[1] == "print"))
+        {
+            if (static_solver.solve())
+                issue_label("Static solution didn't converge, the structure may be a mechanism", WARNING_LABEL_TIME);
+            
+            // Report the most loaded bar
+            int max_id = -1;
+            for (int i = 0; i < bars.size(); i++)
+            {
+                const Bar& b = bars.at(i);
+                if (max_id == -1 || abs_d(b.get_static_force()) > abs_d(bars[max_id].get_static_force()))
+                    max_id = b.id_;
+                if (words_number == 2)
+                    cout << "b" << b.id_ << " force=" << b.get_static_force()
+                         << " strain=" << b.get_static_strain() << endl;
+            }
+            cout << "static: " << static_solver.unknowns() << " unknowns, "
+                 << static_solver.iterations() << " iterations, residual="
+                 << static_solver.residual() << endl;
+            if (max_id != -1)
+                cout << "max force=" << bars[max_id].get_static_force() << " in bar "
+                     << max_id << ", strain=" << bars[max_id].get_static_strain() << endl;
+        }
+        else
+            issue_label("Usage: static [print]", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "profile")
+    {
+        if (words_number == 1)
+        {
+            cout << "profile=" << (profiler.enabled ? "on" : "off") << endl;
+            for (int i = 0; i < PROFILE_PHASES; i++)
+                cout << Profiler::phase_name((ProfilePhase)i) << "="
+                     << profiler.average_ms((ProfilePhase)i) << " ms" << endl;
+        }
+        else if (words_number == 2 && words[1] == "on")
+            profiler.enabled = true;
+        else if (words_number == 2 && words[1] == "off")
+        {
+            profiler.enabled = false;
+            profiler.close_csv();
+        }
+        else if (words_number == 3 && words[1] == "csv" && words[2] == "off")
+            profiler.close_csv();
+        else if (words_number == 3 && words[1] == "csv")
+        {
+            // Relative paths mean the save directory
+            string path = words[2];
+            if (path.find("/") == -1)
+                path = settings.get(SAVE_PATH) + path;
+            if (profiler.open_csv(path))
+                issue_label("Could not open " + path, WARNING_LABEL_TIME);
+            else
+                profiler.enabled = true;
+        }
+        else
+            issue_label("Usage: profile <on/off> or profile csv <file/off>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "threads")
+    {
+        if (words_number == 1)
+            cout << "threads=" << thread_pool.threads() << endl;
+        else if (types == "wn" && get_number<int>(words[1]) > 0)
+            thread_pool.set_threads(get_number<int>(words[1]));
+        else
+            issue_label("Usage: threads <positive int>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "gen")
+    {
+        if (types == "wwn" && get_number<int>(words[2]) > 1)
+        {
+            if (generate(words[1], get_number<int>(words[2])))
+                issue_label("Unknown structure " + words[1], WARNING_LABEL_TIME);
+        }
+        else
+            issue_label("Usage: gen <cloth/bracedcloth/bridge/pratt/tower/delaunay> <size>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "record")
+    {
+        if (words_number == 2 && words[1] == "stop")
+        {
+            if (journal.recording())
+            {
+                ostringstream s;
+                s << "Recorded " << journal.steps() << " steps";
+                issue_label(s.str(), INFO_LABEL_TIME);
+            }
+            journal.stop_recording();
+        }
+        else if (words_number == 2)
+        {
+            // Relative paths mean the save directory
+            string path = words[1];
+            if (path.find("/") == -1)
+                path = settings.get(SAVE_PATH) + path;
+            if (journal.start_recording(path))
+                issue_label("Could not open " + path, WARNING_LABEL_TIME);
+            else
+                issue_label("Recording to " + path, INFO_LABEL_TIME);
+        }
+        else
+            issue_label("Usage: record <file/stop>", INFO_LABEL_TIME);
+    }
+    
+    else if (first_word == "replay")
+    {
+        if (words_number == 2 && words[1] == "stop")
+            journal.stop_replay();
+        else if (words_number == 2)
+        {
+            string path = words[1];
+            if (path.find("/") == -1)
+                path = settings.get(SAVE_PATH) + path;
+            if (journal.start_replay(path))
+                issue_label("Could not replay " + path, WARNING_LABEL_TIME);
+        }
+        else
+            issue_label("Usage: replay <file/stop>", INFO_LABEL_TIME);
+    }
+    
     else if (first_word == "load")
     {
         if (words_number == 2)
@@ -235,7 +654,7 @@ void Interpreter::interpret() const
             if (n < 0)
                 n = 0;
             if (particles.exists(n))
-                particles[n].fixed_ = true;
+                particles[n].set_fixed(true);
         }
         else
             issue_label("Usage: fix <particle id>", INFO_LABEL_TIME);
@@ -243,7 +662,24 @@ void Interpreter::interpret() const
     
     else if (first_word == "trace")
     {
-        if (types == "wn")
+        if (words_number == 2 && words[1] == "on")
+            timeline.enabled = true;
+        else if (words_number == 2 && words[1] == "off")
+            timeline.enabled = false;
+        else if (words_number == 2 && words[1] == "clear")
+            timeline.clear();
+        else if (words_number == 3 && words[1] == "dump")
+        {
+            // Relative paths mean the save directory
+            string path = words[2];
+            if (path.find("/") == -1)
+                path = settings.get(SAVE_PATH) + path;
+            if (timeline.dump(path))
+                issue_label("Could not write " + path, WARNING_LABEL_TIME);
+            else
+                issue_label("Timeline written to " + path, INFO_LABEL_TIME);
+        }
+        else if (types == "wn")
         {
             // Interpret negative numbers to 0
             int n = get_number<int>(words[1]);
@@ -253,7 +689,7 @@ void Interpreter::interpret() const
                 particles[n].trace();
         }
         else
-            issue_label("Usage: trace <particle id>", INFO_LABEL_TIME);
+            issue_label("Usage: trace <particle id> or trace <on/off/clear> or trace dump <file>", INFO_LABEL_TIME);
     }
     
     else if (first_word == "untrace")
@@ -0,0 +1,790 @@
+//
+//  journal.cpp
+//  Trusses
+//
+
+#include "journal.h"
+#include <sstream>
+#include <cstring>
+#include "particle.h"
+#include "bar.h"
+#include "material.h"
+#include "obstacle.h"
+#include "game.h"
+#include "save.h"
+#include "settings.h"
+#include "solver.h"
+#include "relax_kernels.h"
+#include "islands.h"
+#include "constraint_table.h"
+#include "spatial_hash.h"
+#include "self_collision.h"
+#include "temporary_label.h"
+
+// First bytes of every journal, the digit is the version of the format.
+// Journals of other versions are rejected.
+#define JOURNAL_MAGIC "TRJ1"
+
+Journal journal;
+
+// * * * * * * * * * * //
+// Settings which change the result of a step
+struct JournalConfig
+{
+    double step_us;
+    bool gravity;
+    int solver_mode;
+    int relax_method;
+    
+    // The AVX2 kernel was used. It rounds differently from the scalar
+    // one, so the replay has to use the same kernel.
+    bool vectorised;
+    int min_iterations;
+    int max_iterations;
+    double tolerance;
+    bool sleep;
+    double field_cell_size;
+    double grid_cell_size;
+    bool self_collision;
+    double radius;
+    bool simulating;
+};
+
+static JournalConfig current_config()
+{
+    JournalConfig c;
+    c.step_us = game.dt_us();
+    c.gravity = settings.get(GRAVITY);
+    c.solver_mode = solver.mode;
+    c.relax_method = solver.method;
+    c.vectorised = solver.vectorised && fastest_relax_kernel() == relax_avx2;
+    c.min_iterations = solver.min_iterations;
+    c.max_iterations = solver.max_iterations;
+    c.tolerance = solver.tolerance;
+    c.sleep = islands.enabled;
+    c.field_cell_size = Obstacle::field_cell_size;
+    c.grid_cell_size = particle_grid.cell_size;
+    c.self_collision = self_collision.enabled;
+    c.radius = self_collision.radius;
+    c.simulating = game.simulation_running();
+    return c;
+}
+
+// Loads the structure and applies the settings at the start of a replay.
+// Returns 1 if the kernel of the recording isn't supported.
+static int restore(const std::string& scene, const JournalConfig& c)
+{
+    if (c.vectorised && !avx2_supported())
+    {
+        issue_label("The journal was recorded with the AVX2 kernel, which this CPU lacks", WARNING_LABEL_TIME);
+        return 1;
+    }
+    
+    // Distance fields are built while loading if they aren't in the file
+    Obstacle::field_cell_size = c.field_cell_size;
+    std::istringstream in(scene);
+    if (load(in))
+        return 1;
+    
+    game.set_step(c.step_us);
+    settings.set(GRAVITY, c.gravity);
+    solver.mode = (SolverMode)c.solver_mode;
+    solver.method = (RelaxMethod)c.relax_method;
+    solver.vectorised = c.vectorised;
+    solver.min_iterations = c.min_iterations;
+    solver.max_iterations = c.max_iterations;
+    solver.tolerance = c.tolerance;
+    islands.enabled = c.sleep;
+    particle_grid.cell_size = c.grid_cell_size;
+    self_collision.enabled = c.self_collision;
+    self_collision.radius = c.radius;
+    if (c.simulating)
+        game.enter_simulation();
+    return 0;
+}
+
+// Loads the structure again in the middle of a replay. The interface
+// isn't told about the reset and the switches to the editor it involves,
+// and the settings which don't affect the simulation are kept.
+static int reload(const std::string& scene, const JournalConfig& c)
+{
+    void (*editor_entered)() = game.editor_entered;
+    void (*simulation_entered)() = game.simulation_entered;
+    void (*game_reset)() = game.game_reset;
+    game.editor_entered = NULL;
+    game.simulation_entered = NULL;
+    game.game_reset = NULL;
+    Settings kept_settings = settings;
+    
+    int result = restore(scene, c);
+    
+    settings = kept_settings;
+    settings.set(GRAVITY, c.gravity);
+    game.editor_entered = editor_entered;
+    game.simulation_entered = simulation_entered;
+    game.game_reset = game_reset;
+    return result;
+}
+
+// * * * * * * * * * * //
+// Numbers are written in the byte order of the machine. Counts and step
+// differences are written as variable length integers, seven bits a byte.
+template <typename T>
+static void write_raw(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void write_count(std::ostream& out, unsigned long long int n)
+{
+    while (n >= 0x80)
+    {
+        out.put((char)(0x80 | (n & 0x7f)));
+        n >>= 7;
+    }
+    out.put((char)n);
+}
+
+static void write_string(std::ostream& out, const std::string& str)
+{
+    write_count(out, str.size());
+    out.write(str.data(), str.size());
+}
+
+template <typename T>
+static void write_array(std::ostream& out, const std::vector<T>& v)
+{
+    write_count(out, v.size());
+    if (!v.empty())
+        out.write(reinterpret_cast<const char*>(&v[0]), v.size() * sizeof(T));
+}
+
+// Reads the numbers back, failed is set at the end of the data
+class JournalReader
+{
+public:
+    JournalReader(const std::string& bytes): failed(false), data(bytes), pos(0) {}
+    
+    template <typename T>
+    T raw()
+    {
+        T value = T();
+        if (pos + sizeof(T) > data.size())
+            failed = true;
+        else
+            std::memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    
+    unsigned long long int count()
+    {
+        unsigned long long int n = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= data.size())
+            {
+                failed = true;
+                return 0;
+            }
+            unsigned char byte = data[pos++];
+            n |= (unsigned long long int)(byte & 0x7f) << shift;
+            if (byte < 0x80)
+                break;
+        }
+        return n;
+    }
+    
+    std::string string()
+    {
+        unsigned long long int n = count();
+        if (failed || pos + n > data.size())
+        {
+            failed = true;
+            return "";
+        }
+        pos += n;
+        return data.substr(pos - n, n);
+    }
+    
+    // Reads an array of n elements, or of any length if n is -1
+    template <typename T>
+    void array(std::vector<T>& v, long long int n = -1)
+    {
+        unsigned long long int size = count();
+        if (failed || (n >= 0 && size != n) || size > (data.size() - pos) / sizeof(T))
+        {
+            failed = true;
+            v.clear();
+            return;
+        }
+        v.resize(size);
+        if (size > 0)
+            std::memcpy(&v[0], data.data() + pos, size * sizeof(T));
+        pos += size * sizeof(T);
+    }
+    
+    bool at_end() const {return pos >= data.size();}
+    
+    bool failed;
+    
+private:
+    const std::string& data;
+    size_t pos;
+};
+
+static void write_config(std::ostream& out, const JournalConfig& c)
+{
+    write_raw<double>(out, c.step_us);
+    write_raw<char>(out, c.gravity);
+    write_raw<char>(out, c.solver_mode);
+    write_raw<char>(out, c.relax_method);
+    write_raw<char>(out, c.vectorised);
+    write_raw<int>(out, c.min_iterations);
+    write_raw<int>(out, c.max_iterations);
+    write_raw<double>(out, c.tolerance);
+    write_raw<char>(out, c.sleep);
+    write_raw<double>(out, c.field_cell_size);
+    write_raw<double>(out, c.grid_cell_size);
+    write_raw<char>(out, c.self_collision);
+    write_raw<double>(out, c.radius);
+    write_raw<char>(out, c.simulating);
+}
+
+static JournalConfig read_config(JournalReader& in)
+{
+    JournalConfig c;
+    c.step_us = in.raw<double>();
+    c.gravity = in.raw<char>();
+    c.solver_mode = in.raw<char>();
+    c.relax_method = in.raw<char>();
+    c.vectorised = in.raw<char>();
+    c.min_iterations = in.raw<int>();
+    c.max_iterations = in.raw<int>();
+    c.tolerance = in.raw<double>();
+    c.sleep = in.raw<char>();
+    c.field_cell_size = in.raw<double>();
+    c.grid_cell_size = in.raw<double>();
+    c.self_collision = in.raw<char>();
+    c.radius = in.raw<double>();
+    c.simulating = in.raw<char>();
+    return c;
+}
+
+// * * * * * * * * * * //
+// True if every element is in [0, n)
+template <typename T>
+static bool below(const std::vector<T>& v, long long int n)
+{
+    for (size_t i = 0; i < v.size(); i++)
+        if (v[i] < 0 || v[i] >= n)
+            return false;
+    return true;
+}
+
+// Ids of the objects of a slot map, in the order of its container
+template <typename T>
+static std::vector<int> object_ids(const SlotMap<T>& map)
+{
+    std::vector<int> ids(map.size());
+    for (unsigned int i = 0; i < map.size(); i++)
+        ids[i] = map.at(i).id_;
+    return ids;
+}
+
+// The scene doesn't hold the ids, the motion, the masses set by hand,
+// the exact rest lengths, the colours or the sleep of the structures.
+// They are written as they are in memory, with the islands and the
+// constraints compiled from them, as the order of the constraints
+// decides how the next steps are rounded.
+void Journal::write_state(std::ostream& out)
+{
+    write_raw<char>(out, sizeof(Real));
+    write_raw<int>(out, materials.size());
+    write_raw<int>(out, materials.current);
+    
+    std::vector<int> n_connected(particles.size());
+    std::vector<int> connected;
+    for (unsigned int i = 0; i < particles.size(); i++)
+    {
+        const std::vector<int>& bars_connected = particles.at(i).bars_connected;
+        n_connected[i] = (int)bars_connected.size();
+        connected.insert(connected.end(), bars_connected.begin(), bars_connected.end());
+    }
+    write_array(out, object_ids(particles));
+    write_array(out, particles.unused_ids());
+    write_array(out, n_connected);
+    write_array(out, connected);
+    write_array(out, particle_store.position);
+    write_array(out, particle_store.prev_position);
+    write_array(out, particle_store.acceleration);
+    write_array(out, particle_store.inv_mass);
+    write_array(out, particle_store.fixed);
+    write_array(out, particle_store.sleeping);
+    
+    unsigned int n_bars = bars.size();
+    std::vector<int> p1(n_bars), p2(n_bars);
+    std::vector<double> r0(n_bars);
+    std::vector<unsigned int> colour(n_bars);
+    std::vector<unsigned char> material(n_bars);
+    for (unsigned int j = 0; j < n_bars; j++)
+    {
+        const Bar& b = bars.at(j);
+        p1[j] = b.p1_id;
+        p2[j] = b.p2_id;
+        r0[j] = b.r0;
+        colour[j] = b.colour;
+        material[j] = b.material;
+    }
+    write_array(out, object_ids(bars));
+    write_array(out, bars.unused_ids());
+    write_array(out, p1);
+    write_array(out, p2);
+    write_array(out, r0);
+    write_array(out, colour);
+    write_array(out, material);
+    
+    write_array(out, object_ids(obstacles));
+    write_array(out, obstacles.unused_ids());
+    
+    // Out of date islands and constraints are rebuilt before the next step
+    write_raw<char>(out, islands.up_to_date);
+    if (islands.up_to_date)
+    {
+        write_array(out, islands.island);
+        write_array(out, islands.quiet_steps);
+        write_array(out, islands.sleeping);
+        write_array(out, islands.island_start);
+        write_array(out, islands.members);
+    }
+    
+    const ConstraintTable& t = constraints;
+    write_raw<char>(out, t.up_to_date);
+    write_raw<char>(out, t.by_island);
+    if (!t.up_to_date)
+        return;
+    write_array(out, t.p1);
+    write_array(out, t.p2);
+    write_array(out, t.r0);
+    write_array(out, t.stiffness);
+    write_array(out, t.compliance);
+    write_array(out, t.material);
+    write_array(out, t.lambda);
+    write_array(out, t.inv_mass1);
+    write_array(out, t.inv_mass2);
+    write_array(out, t.bar_id);
+    write_array(out, t.colour_start);
+    write_array(out, t.island_batch);
+}
+
+// Puts the state written by write_state onto the scene it was written
+// with. Nothing is changed if it doesn't fit the scene.
+int Journal::read_state(JournalReader& in)
+{
+    unsigned int n = particles.size();
+    unsigned int n_bars = bars.size();
+    if (in.raw<char>() != sizeof(Real) || in.raw<int>() != (int)materials.size())
+        return 1;
+    int current = in.raw<int>();
+    
+    std::vector<int> ids, n_connected, connected;
+    std::vector<unsigned int> free_ids;
+    ParticleStore store;
+    in.array(ids, n);
+    in.array(free_ids);
+    in.array(n_connected, n);
+    in.array(connected);
+    in.array(store.position, n);
+    in.array(store.prev_position, n);
+    in.array(store.acceleration, n);
+    in.array(store.inv_mass, n);
+    in.array(store.fixed, n);
+    in.array(store.sleeping, n);
+    
+    std::vector<int> bar_ids, p1, p2;
+    std::vector<unsigned int> free_bar_ids;
+    std::vector<double> r0;
+    std::vector<unsigned int> colour;
+    std::vector<unsigned char> material;
+    in.array(bar_ids, n_bars);
+    in.array(free_bar_ids);
+    in.array(p1, n_bars);
+    in.array(p2, n_bars);
+    in.array(r0, n_bars);
+    in.array(colour, n_bars);
+    in.array(material, n_bars);
+    
+    std::vector<int> obstacle_ids;
+    std::vector<unsigned int> free_obstacle_ids;
+    in.array(obstacle_ids, obstacles.size());
+    in.array(free_obstacle_ids);
+    
+    Islands new_islands;
+    new_islands.up_to_date = in.raw<char>();
+    if (new_islands.up_to_date)
+    {
+        in.array(new_islands.island, n);
+        in.array(new_islands.quiet_steps);
+        in.array(new_islands.sleeping);
+        in.array(new_islands.island_start, new_islands.quiet_steps.size() + 1);
+        in.array(new_islands.members);
+    }
+    
+    ConstraintTable t;
+    t.up_to_date = in.raw<char>();
+    t.by_island = in.raw<char>();
+    unsigned int n_constraints = 0;
+    if (t.up_to_date)
+    {
+        in.array(t.p1);
+        n_constraints = t.size();
+        in.array(t.p2, n_constraints);
+        in.array(t.r0, n_constraints);
+        in.array(t.stiffness, n_constraints);
+        in.array(t.compliance, n_constraints);
+        in.array(t.material, n_constraints);
+        in.array(t.lambda, n_constraints);
+        in.array(t.inv_mass1, n_constraints);
+        in.array(t.inv_mass2, n_constraints);
+        in.array(t.bar_id, n_constraints);
+        in.array(t.colour_start);
+        in.array(t.island_batch);
+    }
+    if (in.failed || current < 0 || current >= materials.size())
+        return 1;
+    
+    // The ids have to refer to the particles and bars of the state, and
+    // the indices to the particles of the scene
+    std::vector<char> particle_exists(n + free_ids.size(), false);
+    std::vector<char> bar_exists(n_bars + free_bar_ids.size(), false);
+    if (!below(ids, particle_exists.size()) || !below(bar_ids, bar_exists.size()))
+        return 1;
+    for (unsigned int i = 0; i < n; i++)
+        particle_exists[ids[i]] = true;
+    for (unsigned int j = 0; j < n_bars; j++)
+        bar_exists[bar_ids[j]] = true;
+    bool valid = below(connected, bar_exists.size()) && below(p1, particle_exists.size()) &&
+                 below(p2, particle_exists.size()) && below(material, materials.size()) &&
+                 below(t.p1, n) && below(t.p2, n) && below(t.material, materials.size()) &&
+                 below(new_islands.members, n) && below(new_islands.island_start, new_islands.members.size() + 1) &&
+                 new_islands.sleeping.size() == new_islands.quiet_steps.size() &&
+                 !t.colour_start.empty() && t.colour_start.back() == n_constraints &&
+                 below(t.colour_start, n_constraints + 1) && below(t.island_batch, t.colour_start.size());
+    long long int total_connected = 0;
+    for (unsigned int i = 0; i < n && valid; i++)
+    {
+        valid = n_connected[i] >= 0;
+        total_connected += n_connected[i];
+    }
+    for (int k = 0; k < connected.size() && valid; k++)
+        valid = bar_exists[connected[k]];
+    for (unsigned int j = 0; j < n_bars && valid; j++)
+        valid = particle_exists[p1[j]] && particle_exists[p2[j]];
+    if (!valid || total_connected != connected.size())
+        return 1;
+    if (particles.set_ids(ids, free_ids) || bars.set_ids(bar_ids, free_bar_ids) ||
+        obstacles.set_ids(obstacle_ids, free_obstacle_ids))
+        return 1;
+    
+    materials.current = current;
+    for (unsigned int i = 0, k = 0; i < n; k += n_connected[i], i++)
+        particles.at(i).bars_connected.assign(connected.begin() + k, connected.begin() + k + n_connected[i]);
+    particle_store.position.swap(store.position);
+    particle_store.prev_position.swap(store.prev_position);
+    particle_store.acceleration.swap(store.acceleration);
+    particle_store.inv_mass.swap(store.inv_mass);
+    particle_store.fixed.swap(store.fixed);
+    particle_store.sleeping.swap(store.sleeping);
+    for (unsigned int j = 0; j < n_bars; j++)
+    {
+        Bar& b = bars.at(j);
+        b.p1_id = p1[j];
+        b.p2_id = p2[j];
+        b.r0 = r0[j];
+        b.colour = colour[j];
+        b.material = material[j];
+    }
+    
+    new_islands.enabled = islands.enabled;
+    islands = new_islands;
+    constraints = t;
+    return 0;
+}
+
+// * * * * * * * * * * //
+Journal::Journal()
+{
+    is_recording = false;
+    is_replaying = false;
+    finished = false;
+    matches = false;
+    step_count = 0;
+    last_event_step = 0;
+    next_event = 0;
+    run_command = NULL;
+}
+
+int Journal::start_recording(const std::string& filename)
+{
+    stop_recording();
+    stop_replay();
+    
+    out.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return 1;
+    
+    out.write(JOURNAL_MAGIC, 4);
+    write_snapshot();
+    
+    is_recording = true;
+    step_count = 0;
+    last_event_step = 0;
+    return 0;
+}
+
+void Journal::stop_recording()
+{
+    if (!is_recording)
+        return;
+    
+    write_event(EVENT_END);
+    write_raw<unsigned long long int>(out, state_hash());
+    out.close();
+    is_recording = false;
+}
+
+bool Journal::recording() const
+{
+    return is_recording;
+}
+
+int Journal::start_replay(const std::string& filename)
+{
+    stop_recording();
+    stop_replay();
+    
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return 1;
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string data = contents.str();
+    if (data.compare(0, 4, JOURNAL_MAGIC) != 0)
+        return 1;
+    
+    JournalReader in(data);
+    in.raw<int>();
+    std::string scene = in.string();
+    std::string state = in.string();
+    if (in.failed)
+        return 1;
+    
+    // Events until the end of the recording
+    events.clear();
+    unsigned long long int step = 0;
+    while (!in.failed && !in.at_end())
+    {
+        Event e;
+        e.type = (EventType)in.raw<char>();
+        step += in.count();
+        e.step = step;
+        e.particle_id = -1;
+        e.hash = 0;
+        if (e.type == EVENT_COMMAND)
+            e.text = in.string();
+        else if (e.type == EVENT_SIMULATE)
+        {
+            e.text = in.string();
+            e.state = in.string();
+        }
+        else if (e.type == EVENT_ACCELERATION || e.type == EVENT_POSITION)
+        {
+            e.particle_id = in.raw<int>();
+            e.vector.x = in.raw<double>();
+            e.vector.y = in.raw<double>();
+        }
+        else if (e.type == EVENT_END)
+            e.hash = in.raw<unsigned long long int>();
+        if (!in.failed)
+            events.push_back(e);
+        if (e.type == EVENT_END)
+            break;
+    }
+    if (in.failed && events.empty())
+        return 1;
+    
+    // The state is put on the scene once the simulation has been entered,
+    // which wakes up the structures
+    JournalReader snapshot(state);
+    JournalConfig config = read_config(snapshot);
+    if (snapshot.failed || restore(scene, config) || read_state(snapshot))
+        return 1;
+    
+    is_replaying = true;
+    finished = false;
+    matches = false;
+    step_count = 0;
+    next_event = 0;
+    apply_events();
+    return 0;
+}
+
+void Journal::stop_replay()
+{
+    is_replaying = false;
+    events.clear();
+    next_event = 0;
+}
+
+bool Journal::replaying() const
+{
+    return is_replaying;
+}
+
+bool Journal::replay_finished() const
+{
+    return finished;
+}
+
+bool Journal::replay_matches() const
+{
+    return matches;
+}
+
+// * * * * * * * * * * //
+void Journal::write_event(EventType type)
+{
+    out.put((char)type);
+    write_count(out, step_count - last_event_step);
+    last_event_step = step_count;
+}
+
+void Journal::record_command(const std::string& command)
+{
+    if (!is_recording)
+        return;
+    write_event(EVENT_COMMAND);
+    write_string(out, command);
+}
+
+void Journal::record_acceleration(int particle_id, const Vector2d& a)
+{
+    if (!is_recording)
+        return;
+    write_event(EVENT_ACCELERATION);
+    write_raw<int>(out, particle_id);
+    write_raw<double>(out, a.x);
+    write_raw<double>(out, a.y);
+}
+
+void Journal::record_position(int particle_id, const Vector2d& position)
+{
+    if (!is_recording)
+        return;
+    write_event(EVENT_POSITION);
+    write_raw<int>(out, particle_id);
+    write_raw<double>(out, position.x);
+    write_raw<double>(out, position.y);
+}
+
+void Journal::record_mode(bool simulating)
+{
+    if (!is_recording)
+        return;
+    if (!simulating)
+    {
+        write_event(EVENT_EDIT);
+        return;
+    }
+    
+    // Changes made in the editor aren't recorded, so the
+    // structure is stored again as it is when they are done
+    write_event(EVENT_SIMULATE);
+    write_snapshot();
+}
+
+void Journal::write_snapshot()
+{
+    // Doubles need 17 digits to be read back exactly
+    std::ostringstream scene;
+    scene.precision(17);
+    save(scene);
+    std::ostringstream state;
+    write_config(state, current_config());
+    write_state(state);
+    
+    write_string(out, scene.str());
+    write_string(out, state.str());
+}
+
+void Journal::step_done()
+{
+    if (!is_recording && !is_replaying)
+        return;
+    step_count++;
+    apply_events();
+}
+
+unsigned long long int Journal::steps() const
+{
+    return step_count;
+}
+
+void Journal::apply_events()
+{
+    while (is_replaying && next_event < events.size() && events[next_event].step <= step_count)
+    {
+        // The commands can stop the replay, which clears the events
+        Event e = events[next_event++];
+        if (e.type == EVENT_COMMAND && run_command)
+            run_command(e.text);
+        else if (e.type == EVENT_ACCELERATION && particles.exists(e.particle_id))
+            particles[e.particle_id].set_external_acceleration(e.vector);
+        else if (e.type == EVENT_POSITION && particles.exists(e.particle_id))
+        {
+            particles[e.particle_id].position() = e.vector;
+            particles[e.particle_id].wake();
+        }
+        else if (e.type == EVENT_SIMULATE)
+        {
+            JournalReader snapshot(e.state);
+            JournalConfig config = read_config(snapshot);
+            config.simulating = false;
+            if (snapshot.failed || reload(e.text, config) || read_state(snapshot))
+            {
+                stop_replay();
+                break;
+            }
+            game.enter_simulation();
+        }
+        else if (e.type == EVENT_EDIT)
+            game.enter_editor();
+        else if (e.type == EVENT_END)
+        {
+            finished = true;
+            matches = e.hash == state_hash();
+            stop_replay();
+            if (matches)
+                issue_label("Replay finished, the state matches the recording", INFO_LABEL_TIME);
+            else
+                issue_label("Replay finished, the state differs from the recording", WARNING_LABEL_TIME);
+        }
+    }
+}
+
+// FNV-1a of the bits of the positions, in the order of the particles
+unsigned long long int Journal::state_hash()
+{
+    unsigned long long int hash = 14695981039346656037ull;
+    for (int i = 0; i < particle_store.size(); i++)
+    {
+        double xy[2] = {particle_store.position[i].x, particle_store.position[i].y};
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(xy);
+        for (size_t k = 0; k < sizeof(xy); k++)
+        {
+            hash ^= bytes[k];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
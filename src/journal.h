@@ -0,0 +1,121 @@
+//
+//  journal.h
+//  Trusses
+//
+
+#ifndef __Trusses__journal__
+#define __Trusses__journal__
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "vector2d.h"
+
+class JournalReader;
+
+// Records what changes the course of the simulation in a compact binary
+// file, so that a session can be replayed exactly, with or without the
+// interface. The journal starts with the structure and the solver
+// settings, followed by the commands, the forces of the drag tool and
+// the switches between the editor and the simulation, each tagged with
+// the number of steps simulated before it.
+//
+// The structure is stored as it is when the recording starts, moving
+// or not, and again each time the simulation is entered, so that the
+// changes made in the editor are stored too. Recording changes nothing
+// in the session, only the replay loads these snapshots. The frame
+// times don't matter, as the simulation only advances in fixed steps. Changes made with the tools
+// during the simulation other than dragging, and the files loaded by
+// commands, aren't stored, so they have to be avoided or present during
+// the replay. The journal is only complete once the recording stops.
+class Journal
+{
+public:
+    Journal();
+    
+    // Starts writing to the file. Returns 1 if it couldn't be opened.
+    int start_recording(const std::string& filename);
+    
+    // Writes the final step and state, and closes the file
+    void stop_recording();
+    
+    bool recording() const;
+    
+    // Loads the structure and settings of the journal, and replays its
+    // events as the simulation steps. Returns 1 if the file couldn't be read.
+    int start_replay(const std::string& filename);
+    
+    void stop_replay();
+    
+    bool replaying() const;
+    
+    // True once all the recorded steps have been replayed. The replay
+    // matches if the state was the same as at the end of the recording.
+    bool replay_finished() const;
+    bool replay_matches() const;
+    
+    // Events, ignored unless recording
+    void record_command(const std::string& command);
+    void record_acceleration(int particle_id, const Vector2d& a);
+    void record_position(int particle_id, const Vector2d& position);
+    void record_mode(bool simulating);
+    
+    // Called after every simulation step. Applies the events of
+    // the replay which were recorded before the next step.
+    void step_done();
+    
+    // Steps simulated since the recording or replay started
+    unsigned long long int steps() const;
+    
+    // Hash of the positions of all the particles
+    static unsigned long long int state_hash();
+    
+    // Executes the replayed commands. Without it they are skipped.
+    void (*run_command)(const std::string& command);
+    
+private:
+    enum EventType {EVENT_COMMAND, EVENT_ACCELERATION, EVENT_POSITION,
+                    EVENT_SIMULATE, EVENT_EDIT, EVENT_END};
+    
+    struct Event
+    {
+        EventType type;
+        unsigned long long int step;
+        int particle_id;
+        Vector2d vector;
+        std::string text;
+        unsigned long long int hash;
+        
+        // Settings and state stored with the scene (in text) of a switch
+        // to the simulation, in the format of the start of the journal
+        std::string state;
+    };
+    
+    // Begins the next event in the file
+    void write_event(EventType type);
+    
+    // Writes the structure in text, the settings and the state which
+    // the text doesn't hold exactly (see write_state)
+    void write_snapshot();
+    
+    static void write_state(std::ostream& out);
+    static int read_state(JournalReader& in);
+    
+    // Applies the replayed events recorded before the current step
+    void apply_events();
+    
+    std::ofstream out;
+    bool is_recording;
+    unsigned long long int step_count;
+    unsigned long long int last_event_step;
+    
+    std::vector<Event> events;
+    unsigned int next_event;
+    bool is_replaying;
+    bool finished;
+    bool matches;
+};
+
+extern Journal journal;
+
+#endif /* defined(__Trusses__journal__) */
@@ -14,16 +14,15 @@
 #include <vector>
 #include <cmath>
 #include <map>
+#include <cstdlib>
 
-#include "math.h"
 #include "particle.h"
 #include "bar.h"
+#include "material.h"
 #include "obstacle.h"
-#include "interface.h"
-#include "interpreter.h"
 #include "temporary_label.h"
-#include "bars_tool.h"
 #include "game.h"
+#include "timeline.h"
 
 // * * * * * * * * * * //
 template<typename T>
@@ -87,6 +86,30 @@ T number(std::string str)
 // * * * * * * * * * * //
 int load(std::string filename)
 {
+    // Open the file
+    std::ifstream file(filename.c_str());
+    
+    // Check if the file was opened successfully
+    if (!file.is_open())
+    {
+        game.reset();
+        return 1;
+    }
+    
+    load(file);
+    
+    // Close the file
+    file.close();
+    
+    issue_label("File loaded", INFO_LABEL_TIME);
+    
+    return 0;
+}
+
+int load(std::istream& file)
+{
+    TraceSpan span("load");
+    
     // TODO
     // Check if the file is valid
     
@@ -95,19 +118,20 @@ int load(std::string filename)
     
     game.reset();
     
-    // Open the file
-    std::ifstream file(filename.c_str());
-    
-    // Check if the file was opened successfully
-    if (!file.is_open())
-        return 1;
-    
     // This map is necessary as particles are saved by ids,
     // and ids do not necessarily range uniformly from 0 to n-1.
     // They might have gaps, for example 0,1,2,3,5,6,8,9.
     // We therefore need to map these imported ids to 0,1,2,3,4,5,6,7
     // or etc.
     std::map<int, int> particles_map;
+    std::map<int, int> obstacles_map;
+    std::map<int, int> materials_map;
+    bool legacy_bars = false;
+    
+    // Distance fields saved in the file are used instead of
+    // computing them again, the missing ones are built at the end
+    double field_cell_size = Obstacle::field_cell_size;
+    Obstacle::field_cell_size = 0.0;
     
     // Read the file line by line
     std::string line;
@@ -146,16 +170,62 @@ int load(std::string filename)
             }
         }
         
+        // A material
+        else if (line.substr(0, 1) == "m")
+        {
+            // Limits can be "inf", which streams don't read
+            std::istringstream s(line.substr(line.find(' ') + 1, std::string::npos));
+            std::vector<std::string> words;
+            std::string word;
+            while (s >> word)
+                words.push_back(word);
+            
+            if (words.size() == 6 || words.size() == 7)
+            {
+                Material m;
+                m.modulus = strtod(words[0].c_str(), NULL);
+                m.yield_strain = strtod(words[1].c_str(), NULL);
+                m.density = strtod(words[2].c_str(), NULL);
+                m.tension_limit = strtod(words[3].c_str(), NULL);
+                m.compression_limit = strtod(words[4].c_str(), NULL);
+                m.name = words[5];
+                m.compliance = words.size() == 7 ? strtod(words[6].c_str(), NULL) : -1.0;
+                
+                // The same checks as the material command, colours
+                // are divided by the yield strain
+                int m_id = number<int>(line.substr(1, line.find(" ")));
+                if (m.modulus > 0.0 && m.yield_strain > 0.0 && m.density >= 0.0)
+                    materials_map[m_id] = materials.set(m);
+            }
+        }
+        
         // A bar
         else if (line.substr(0, 1) == "b")
         {
             std::vector<double> v;
             read_numbers(line, v);
             
-            if (v.size() == 3)
-                Bar::create(particles_map[v[0]], particles_map[v[1]], v[2]);
-            else if (v.size() == 2)
-                Bar::create(particles_map[v[0]], particles_map[v[1]]);
+            if (v.size() == 4)
+            {
+                int bar_id = Bar::create(particles_map[v[0]], particles_map[v[1]], v[2]);
+                int m_id = (int)v[3];
+                if (bar_id != -1 && materials_map.count(m_id) && materials_map[m_id] != -1)
+                    bars[bar_id].set_material(materials_map[m_id]);
+            }
+            else if (v.size() == 3 || v.size() == 2)
+            {
+                // Files saved before there were materials keep their
+                // physics, and so do the bars added to them
+                if (!legacy_bars)
+                {
+                    materials.current = materials.legacy(LEGACY_COMPLIANCE);
+                    legacy_bars = true;
+                }
+                if (v.size() == 3)
+                    Bar::create(particles_map[v[0]], particles_map[v[1]], v[2]);
+                else
+                    Bar::create(particles_map[v[0]], particles_map[v[1]]);
+            }
         }
         
         // An obstacle
@@ -169,15 +239,30 @@ int load(std::string filename)
             {
                 for (size_t i = 0; i < v.size(); i+=2)
                     poly.add_point(Vector2d(v[i], v[i+1]));
-                Obstacle::create(poly);
+                int o_id = number<int>(line.substr(1, line.find(" ")));
+                obstacles_map[o_id] = Obstacle::create(poly);
             }
         }
+        
+        // Distance field of an obstacle
+        else if (line.substr(0, 1) == "s")
+        {
+            std::vector<double> v;
+            read_numbers(line, v);
+            
+            // Fields are only used while they are turned on (see sdf), and
+            // the ones sampled with other cells are built again at the end
+            int o_id = number<int>(line.substr(1, line.find(" ")));
+            if (field_cell_size > 0.0 && obstacles_map.count(o_id) && obstacles.exists(obstacles_map[o_id]))
+                obstacles[obstacles_map[o_id]].set_field(v, field_cell_size);
+        }
     }
     
-    // Close the file
-    file.close();
-    
-    issue_label("File loaded", INFO_LABEL_TIME);
+    Obstacle::field_cell_size = field_cell_size;
+    if (field_cell_size > 0.0)
+        for (int i = 0; i < obstacles.size(); i++)
+            if (obstacles.at(i).distance_field().empty())
+                obstacles.at(i).build_field(field_cell_size);
     
     return 0;
 }
@@ -187,6 +272,17 @@ void save(std::string filename)
     // Open the file
     std::ofstream file(filename.c_str());
     
+    save(file);
+    
+    // Close the file
+    file.close();
+    
+    std::string text = "Saved as " + filename;
+    issue_label(text, INFO_LABEL_TIME);
+}
+
+void save(std::ostream& file)
+{
     // Print time
     file << date_str() << ' ' << time_str() << std::endl << std::endl;
     
@@ -194,21 +290,34 @@ void save(std::string filename)
     for (int i = 0; i < particles.size(); i++)
     {
         Particle& p = particles.at(i);
-        if (p.fixed_)
+        if (p.fixed())
             file << 'f';
         else
             file << 'p';
-        file << p.id_ << ' ' << p.position_;
+        file << p.id_ << ' ' << p.position();
+        file << std::endl;
+    }
+    file << std::endl;
+    
+    // Print materials
+    // m-material_index modulus yield_strain density tension_limit compression_limit name [compliance]
+    for (unsigned int i = 0; i < materials.size(); i++)
+    {
+        file << 'm' << i << ' ' << materials.modulus[i] << ' ' << materials.yield_strain[i] << ' ';
+        file << materials.density[i] << ' ' << materials.tension_limit[i] << ' ';
+        file << materials.compression_limit[i] << ' ' << materials.name[i];
+        if (materials.compliance[i] >= 0.0)
+            file << ' ' << materials.compliance[i];
         file << std::endl;
     }
     file << std::endl;
     
     // Print bars
-    // b-bar_id particle1_id particle2_id strain
+    // b-bar_id particle1_id particle2_id strain material_index
     for (int i = 0; i < bars.size(); i++)
     {
         Bar& b = bars.at(i);
-        file << 'b' << b.id_ << ' ' << b.p1_id << ' ' << b.p2_id << ' ' << b.get_strain() << ' ' << std::endl;
+        file << 'b' << b.id_ << ' ' << b.p1_id << ' ' << b.p2_id << ' ' << b.get_strain() << ' ' << b.get_material() << std::endl;
     }
     file << std::endl;
     
@@ -219,46 +328,15 @@ void save(std::string filename)
         file << "o" << ob.id_;
         for (size_t i = 0; i < ob.points.size(); i++)
             file << " " << ob.points[i];
-        file << std::endl << std::endl;
-    }
-    
-    // Close the file
-    file.close();
-    
-    std::string text = "Saved as " + filename;
-    issue_label(text, INFO_LABEL_TIME);
-}
-
-void create_cloth(int n, double d, Vector2d bottom_left_corner, bool fix)
-{
-    double x0 = bottom_left_corner.x;
-    double y0 = bottom_left_corner.y;
-    int id0 = particles.size();
-    
-    bool fixed = false;
-    
-    // Create particles
-    for (int j = 0; j < n; j++)
-    {
-        if (fix)
-            fixed = (j == n-1) ? true : false;
+        file << std::endl;
         
-        for (int i = 0; i < n; i++)
+        // s-obstacle_id x0 y0 cell_size nx ny values
+        if (!ob.distance_field().empty())
         {
-            if (fixed)
-                Particle::create(x0 + i * d, y0 + j * d, true);
-            else
-                Particle::create(x0 + i * d, y0 + j * d, false);
+            file << "s" << ob.id_ << ' ';
+            ob.distance_field().write(file);
+            file << std::endl;
         }
+        file << std::endl;
     }
-    
-    // Create horizontal connections
-    for (int j = 0; j < n; j++)
-        for (int i = 0; i < n-1; i++)
-            Bar::create(id0 + j * n + i, id0 + j * n + i + 1);
-    
-    // Create vertical connections
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j < n-1; j++)
-            Bar::create(id0 + i + n * j, id0 + i + n * (j + 1));
 }
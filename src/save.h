@@ -11,14 +11,15 @@
 
 #include <iostream>
 
-class Vector2d;
-
 // * * * * * * * * * * //
 int load(std::string filename);
 void save(std::string filename);
 
-// TODO: Move this out of here
-void create_cloth(int n, double d, Vector2d bottom_left_corner, bool fix);
+// Reads a structure in the .tr format, replacing the current one
+int load(std::istream& in);
+
+// Writes the current structure in the .tr format
+void save(std::ostream& out);
 
 // * * * * * * * * * * //
 std::string date_str();